@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../libs/command_queue.h"
+
+#define CLIENTS 1000 // Connected clients
+#define COMMANDS_PER_CLIENT 10 // Commands each client sends per tick
+#define TICKS 20 // Ticks measured per approach
+#define NS_PER_SEC 1e9
+
+// HELPER FUNCTIONS
+
+// Returns a monotonic timestamp in seconds
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / NS_PER_SEC;
+}
+
+// Orders two timestamps like the server does
+static int compare(const struct timespec *a, const struct timespec *b) {
+    if (a->tv_sec != b->tv_sec) {
+        return (a->tv_sec < b->tv_sec) ? -1 : 1;
+    }
+    return (a->tv_nsec > b->tv_nsec) - (a->tv_nsec < b->tv_nsec);
+}
+
+// The exchange sort the server used to run over its single global queue, swapping every field
+static void bubble_sort(queued_command *head) {
+    for (queued_command *i = head; i; i = i->next) {
+        for (queued_command *j = i->next; j; j = j->next) {
+            if (compare(&i->timestamp, &j->timestamp) > 0) {
+                queued_command tmp = *i;
+                i->username = j->username;
+                i->role = j->role;
+                i->command_str = j->command_str;
+                i->client_version = j->client_version;
+                i->timestamp = j->timestamp;
+                j->username = tmp.username;
+                j->role = tmp.role;
+                j->command_str = tmp.command_str;
+                j->client_version = tmp.client_version;
+                j->timestamp = tmp.timestamp;
+            }
+        }
+    }
+}
+
+// Queues one tick of traffic: each round, every client sends one command, so the clients'
+// timestamps interleave as they would with real concurrent senders
+static void send_tick(command_source **sources) {
+    char command[32];
+    parsed_command op = { CMD_INSERT, 0, 0, 0, 0, 0 };
+    for (int round = 0; round < COMMANDS_PER_CLIENT; round++) {
+        for (int c = 0; c < CLIENTS; c++) {
+            snprintf(command, sizeof(command), "INSERT %d x", round);
+            enqueue_command(&sources[c]->queue, "user", (uint32_t)c + 1, "write", command, &op, 0);
+        }
+    }
+}
+
+// Checks a drained batch is complete and in timestamp order
+static int check_batch(const queued_command *batch) {
+    size_t count = 0;
+    for (const queued_command *c = batch; c; c = c->next) {
+        if (c->next && compare(&c->timestamp, &c->next->timestamp) > 0) {
+            return 0;
+        }
+        count++;
+    }
+    return count == (size_t)CLIENTS * COMMANDS_PER_CLIENT;
+}
+
+// BENCHMARK
+
+int main(void) {
+    command_inbox inbox;
+    command_inbox_init(&inbox);
+    command_source **sources = malloc(CLIENTS * sizeof(command_source *));
+    for (int c = 0; c < CLIENTS; c++) {
+        sources[c] = command_inbox_open(&inbox);
+    }
+
+    double merge_time = 0;
+    double sort_time = 0;
+    int ok = 1;
+    for (int tick = 0; tick < TICKS; tick++) {
+        // Per-client FIFOs merged with the min-heap
+        send_tick(sources);
+        double start = now();
+        queued_command *batch = command_inbox_drain(&inbox);
+        merge_time += now() - start;
+        ok &= check_batch(batch);
+
+        // The same commands as one global list in arrival order, bubble sorted
+        start = now();
+        bubble_sort(batch);
+        sort_time += now() - start;
+        ok &= check_batch(batch);
+        free_command_queue(&batch);
+    }
+
+    printf("%d clients x %d commands per tick, mean over %d ticks\n", CLIENTS, COMMANDS_PER_CLIENT, TICKS);
+    printf("%-28s %12.3f ms\n", "heap merge (drain)", merge_time / TICKS * 1e3);
+    printf("%-28s %12.3f ms\n", "bubble sort (old)", sort_time / TICKS * 1e3);
+    printf("%-28s %11.1fx\n", "speedup", sort_time / merge_time);
+    if (!ok) {
+        fprintf(stderr, "a batch was incomplete or out of order\n");
+    }
+
+    for (int c = 0; c < CLIENTS; c++) {
+        command_source_close(sources[c]);
+    }
+    command_inbox_destroy(&inbox);
+    free(sources);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../libs/scan.h"
+
+// Compares every scanning kernel at each level the CPU supports. All five have SSE2 and AVX2
+// forms; the scalar column is the portable fallback, where find_newline is glibc's memchr.
+
+#define MIN_SIZE 1024 // 1 KB
+#define MAX_SIZE (100 * 1024 * 1024) // 100 MB
+#define BYTES_PER_RUN (256u * 1024 * 1024) // Scan at least this much per measurement
+#define LINE_LEN 64 // Average line length of the generated text
+#define NS_PER_SEC 1e9
+
+// Keeps the compiler from discarding kernel results
+static volatile size_t sink;
+
+// HELPER FUNCTIONS
+
+// Returns a monotonic timestamp in seconds
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / NS_PER_SEC;
+}
+
+// Fills a buffer with lowercase text; lines end in '\n' only if with_newlines is set.
+// The text never contains a list prefix or a non-printable byte, so searches run to the end.
+static void fill_text(char *buf, size_t len, int with_newlines) {
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (char)('a' + x % 26);
+        if (with_newlines && x % LINE_LEN == 0) {
+            buf[i] = '\n';
+        }
+    }
+}
+
+// Runs one kernel over the buffer enough times to be measurable and returns GB/s
+static double measure(const scan_kernels *k, int which, const char *text, const char *plain, size_t len) {
+    size_t reps = BYTES_PER_RUN / len;
+    if (reps == 0) {
+        reps = 1;
+    }
+    double start = 0;
+    for (size_t r = 0; r <= reps; r++) {
+        if (r == 1) {
+            start = now(); // The first pass only warms caches and vector units
+        }
+        switch (which) {
+        case 0:
+            sink += (size_t)k->find_newline(plain, len);
+            break;
+        case 1:
+            sink += (size_t)k->find_last_newline(plain, len);
+            break;
+        case 2:
+            sink += k->count_newlines(text, len);
+            break;
+        case 3:
+            sink += (size_t)k->find_list_prefix(text, len);
+            break;
+        default:
+            sink += k->find_non_printable(plain, len);
+            break;
+        }
+    }
+    double elapsed = now() - start;
+    return (double)len * (double)reps / elapsed / NS_PER_SEC;
+}
+
+// Formats a byte count as KB or MB
+static void format_size(size_t len, char *out, size_t out_len) {
+    if (len >= 1024 * 1024) {
+        snprintf(out, out_len, "%zu MB", len / (1024 * 1024));
+    } else {
+        snprintf(out, out_len, "%zu KB", len / 1024);
+    }
+}
+
+// BENCHMARK
+
+int main(void) {
+    static const char *names[] = {
+        "find_newline", "find_last_newline", "count_newlines", "find_list_prefix", "find_non_printable"
+    };
+    const scan_kernels *levels[] = {
+        scan_get_kernels(SCAN_SCALAR), scan_get_kernels(SCAN_SSE2), scan_get_kernels(SCAN_AVX2)
+    };
+    size_t sizes[] = { MIN_SIZE, 16 * 1024, 256 * 1024, 1024 * 1024, 16 * 1024 * 1024, MAX_SIZE };
+
+    char *text = malloc(MAX_SIZE);
+    char *plain = malloc(MAX_SIZE);
+    if (!text || !plain) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    fill_text(text, MAX_SIZE, 1);
+    fill_text(plain, MAX_SIZE, 0);
+
+    printf("selected kernels: %s\n\n", scan->name);
+    printf("%-20s %8s %12s %12s %12s %9s\n", "kernel", "size", "scalar GB/s", "sse2 GB/s", "avx2 GB/s", "speedup");
+    for (int which = 0; which < 5; which++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            char size_str[32];
+            format_size(sizes[s], size_str, sizeof(size_str));
+            double rate[3] = { 0, 0, 0 };
+            for (int l = 0; l < 3; l++) {
+                if (levels[l]) {
+                    rate[l] = measure(levels[l], which, text, plain, sizes[s]);
+                }
+            }
+            double best = (rate[2] > rate[1]) ? rate[2] : rate[1];
+            printf("%-20s %8s %12.2f %12.2f %12.2f %8.1fx\n",
+                   names[which], size_str, rate[0], rate[1], rate[2], best / rate[0]);
+        }
+    }
+
+    free(text);
+    free(plain);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "document.h"
+
+#define ARENA_BLOCK_SIZE 4096 // Default block size (larger requests get a block of their own)
+
+/*
+ * Initialises an empty arena (the first allocation creates its first block)
+ */
+void arena_init(arena *a);
+
+/*
+ * Frees every block owned by the arena
+ */
+void arena_destroy(arena *a);
+
+/*
+ * Returns size bytes of storage that stays valid until the next reset
+ */
+void *arena_alloc(arena *a, size_t size);
+
+/*
+ * Copies a string into the arena
+ */
+char *arena_strdup(arena *a, const char *str);
+
+/*
+ * Releases every allocation by rewinding to the first block. Standard-size blocks are kept for
+ * reuse; blocks made for larger requests are freed.
+ */
+void arena_reset(arena *a);
+
+#endif
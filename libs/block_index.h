@@ -0,0 +1,39 @@
+#ifndef BLOCK_INDEX_H
+#define BLOCK_INDEX_H
+
+#include <stddef.h>
+#include "document.h"
+
+/*
+ * Initialises an empty index
+ */
+void block_index_init(block_index *idx);
+
+/*
+ * Frees the index's lists
+ */
+void block_index_free(block_index *idx);
+
+/*
+ * Brings the index up to date after the text in [start, old_end) was replaced by
+ * [start, new_end). Only the lines starting in the rewritten region are rescanned;
+ * the blocks after it are shifted by the change in length.
+ */
+void block_index_update(document *doc, size_t start, size_t old_end, size_t new_end);
+
+/*
+ * Returns the block of the given type starting exactly at pos, or NULL
+ */
+const block *block_index_at(const block_index *idx, block_type type, size_t pos);
+
+/*
+ * Returns the last block of the given type starting at or before pos, or NULL
+ */
+const block *block_index_last_before(const block_index *idx, block_type type, size_t pos);
+
+/*
+ * Returns the name of a block type as used by OUTLINE? (e.g. "ORDERED_LIST")
+ */
+const char *block_type_name(block_type type);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef BYTE_BUFFER_H
+#define BYTE_BUFFER_H
+
+#include <stddef.h>
+
+/*
+ * Growable run of bytes that doubles its allocation as it fills. Start one as { NULL, 0, 0 }
+ * and reuse it by resetting len, which keeps the allocation.
+ */
+typedef struct {
+    char *data; // Bytes written so far (not null terminated)
+    size_t len; // Bytes in use
+    size_t capacity; // Bytes allocated
+} byte_buffer;
+
+/*
+ * Grows the buffer so at least extra more bytes fit after len
+ */
+void byte_buffer_reserve(byte_buffer *b, size_t extra);
+
+/*
+ * Copies len bytes onto the end of the buffer
+ */
+void byte_buffer_append(byte_buffer *b, const void *data, size_t len);
+
+/*
+ * Frees the buffer's memory and leaves it empty
+ */
+void byte_buffer_free(byte_buffer *b);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include "document.h"
+
+#define CHECKPOINT_PATH "doc.checkpoint" // Checkpoint image kept next to the journal
+#define CHECKPOINT_EVERY_VERSIONS 1024 // Versions committed between periodic checkpoints
+#define CHECKPOINT_MAGIC "MDCP"
+#define CHECKPOINT_FORMAT 1 // Bumped whenever the layout below changes
+
+/*
+ * Header of a checkpoint image. The document text follows it directly, with the
+ * chunk contents written back to back in document order.
+ */
+typedef struct {
+    char magic[4]; // CHECKPOINT_MAGIC (not null terminated)
+    uint32_t format; // CHECKPOINT_FORMAT
+    uint64_t version; // Document version captured by the image
+    uint64_t length; // Bytes of text following the header
+    uint32_t checksum; // FNV-1a over the text
+    uint32_t reserved; // Always zero
+} checkpoint_header;
+
+/*
+ * Writes a pinned snapshot to path atomically: the image goes to a temporary file,
+ * is fsynced and then renamed over the old checkpoint. Returns 0 on success and -1 on failure.
+ */
+int checkpoint_write(const snapshot *snap, const char *path);
+
+/*
+ * Loads the checkpoint at path into an empty document by mapping it and packing the text
+ * straight into full chunks. Returns 1 if a checkpoint was loaded, 0 if there is none and
+ * -1 if it exists but is unreadable or corrupt (the document is left empty).
+ */
+int checkpoint_load(document *doc, const char *path);
+
+#endif
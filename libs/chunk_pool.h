@@ -0,0 +1,57 @@
+#ifndef CHUNK_POOL_H
+#define CHUNK_POOL_H
+
+#include "document.h"
+
+#define SLAB_SIZE 16384 // Bytes per slab page (a power of two, slabs are aligned to it)
+#define SLAB_HIGH_WATERMARK 4 // Empty slabs kept for reuse before they are released
+
+/*
+ * Initialises an empty pool (no slabs are allocated until the first chunk is needed)
+ */
+void chunk_pool_init(chunk_pool *pool);
+
+/*
+ * Releases every slab and node block in the pool at once, including chunks still in use
+ */
+void chunk_pool_destroy(chunk_pool *pool);
+
+/*
+ * Hands out an empty, unlinked chunk (length and newline count zeroed).
+ * Never returns NULL: the process aborts if no slab can be allocated.
+ */
+chunk *chunk_pool_alloc(chunk_pool *pool);
+
+/*
+ * Returns a chunk to its slab's free list, trimming empty slabs above the high watermark
+ */
+void chunk_pool_free(chunk_pool *pool, chunk *c);
+
+/*
+ * Hands back a chunk that was unlinked from the document at the given version.
+ * It is freed straight away unless reclamation is deferred, in which case it is kept
+ * until chunk_pool_reclaim shows no snapshot of that version is left.
+ */
+void chunk_pool_retire(chunk_pool *pool, chunk *c, uint64_t version);
+
+/*
+ * Hands out an uninitialised chunk tree node. Like chunk_pool_alloc, it aborts when out of memory.
+ */
+chunk_node *chunk_pool_alloc_node(chunk_pool *pool);
+
+/*
+ * Returns a tree node that no snapshot can see to the free list
+ */
+void chunk_pool_free_node(chunk_pool *pool, chunk_node *n);
+
+/*
+ * Hands back a tree node that was replaced at the given version, deferred like chunk_pool_retire
+ */
+void chunk_pool_retire_node(chunk_pool *pool, chunk_node *n, uint64_t version);
+
+/*
+ * Frees every retired chunk and tree node that is not visible in any version from oldest_version onwards
+ */
+void chunk_pool_reclaim(chunk_pool *pool, uint64_t oldest_version);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef CHUNK_TREE_H
+#define CHUNK_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "document.h"
+
+#define DOC_HASH_MOD ((1ull << 61) - 1) // Mersenne prime modulus of the document hash
+#define DOC_HASH_BASE 0x0a3b1c5d7e9f2461ull // Polynomial base of the document hash
+
+/*
+ * Finds the chunk containing a position and stores its offset within that chunk.
+ * Returns NULL if the position is at or past the end of the document.
+ */
+chunk *chunk_tree_find(const document *doc, size_t pos, size_t *local_offset);
+
+/*
+ * Replaces the chunks covering [start, end) with a list of new chunks linked through next
+ * (which may be empty), in the list and the tree. Both ends must fall on chunk boundaries.
+ * The new chunks' contents must be final: linked chunks are never modified in place. The
+ * replaced chunks are retired at the document's version. Only the tree nodes on the paths
+ * to the two ends are copied; a snapshot's tree is never changed.
+ */
+void chunk_tree_replace(document *doc, size_t start, size_t end, chunk *first);
+
+/*
+ * Returns the number of newline characters strictly before a position
+ */
+size_t chunk_tree_newlines_before(const document *doc, size_t pos);
+
+/*
+ * Returns the document position of the newline with the given zero-based index
+ * (the caller guarantees index < total number of newlines)
+ */
+size_t chunk_tree_find_newline(const document *doc, size_t index);
+
+/*
+ * Counts the newline characters in a buffer (used to keep chunk->newlines current)
+ */
+size_t count_newlines(const char *data, size_t len);
+
+/*
+ * Extends a chunk's hash with bytes appended to its data (used while the chunk is being filled)
+ */
+void chunk_hash_append(chunk *c, const char *data, size_t len);
+
+/*
+ * Returns the hash of the document's text: the sum of text[i] * DOC_HASH_BASE^(length - 1 - i)
+ * modulo DOC_HASH_MOD. It depends only on the text, not on how it is split into chunks, and
+ * is kept current by the tree's subtree totals, so reading it is O(1).
+ */
+uint64_t chunk_tree_hash(const document *doc);
+
+/*
+ * In-order walk over the chunks of a tree, such as a pinned snapshot's
+ */
+typedef struct {
+    const chunk_node **stack; // Nodes whose chunk and right subtree are still to come
+    size_t depth; // Number of nodes on the stack
+    size_t capacity; // Allocated stack slots
+} chunk_iter;
+
+/*
+ * Starts a walk over a (possibly empty) tree
+ */
+void chunk_iter_init(chunk_iter *it, const chunk_node *root);
+
+/*
+ * Returns the next chunk in document order, or NULL once the walk is over
+ */
+const chunk *chunk_iter_next(chunk_iter *it);
+
+/*
+ * Frees the walk's stack
+ */
+void chunk_iter_free(chunk_iter *it);
+
+#endif
@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include "document.h"
 
 /*
  *Represents a single line in the client-side log of broadcasts
  */ 
 typedef struct log_line {
-    char *line; // Text of the log entry (e.g., VERSION, EDIT, END)
+    char *line; // Text of the log entry (e.g., VERSION, EDIT, END), or NULL for a primitive
+    edit *op; // Primitive received as a frame, only formatted as its OP line when printed
     struct log_line *next; // Pointer to the next log entry
 } log_line;
\ No newline at end of file
@@ -2,7 +2,10 @@
 #define COMMAND_QUEUE_H
 
 #include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <time.h>
+#include "helper.h"
 
 /*
  * Represents a single command from a client.
@@ -10,27 +13,105 @@
  */
 typedef struct queued_command {
     char *username; // Name of client issuing command
+    uint32_t user_id; // Id the server assigned to the client's connection
     char *role; // Client's role (i.e. "read" or "write")
     char *command_str; // The actual command text
+    parsed_command op; // The command parsed by the client thread (its text slice points into command_str)
     uint64_t client_version; // Document version of client when sending
     struct timespec timestamp; // Time when command was received
-    struct queued_command *next; // Pointer to next command in queue
+    struct queued_command *next; // Pointer to next command in a drained batch
+    _Atomic(struct queued_command *) queue_next; // Link to the next push while in the command_queue
 } queued_command;
 
 /*
- * Adds a new command to the end of the command queue (stores user info, command, client version and timestamp)
- */ 
-void enqueue_command(queued_command **head, const char *user, const char *role, const char *cmd, uint64_t version);
+ * Lock-free multi-producer, single-consumer queue of commands.
+ * Producers (client threads) push in O(1) with one atomic exchange and one store, without
+ * waiting for each other or for the consumer. The consumer (broadcast thread) drains the
+ * queue in batches. Nodes are linked from the oldest (head) to the newest (tail); the stub
+ * keeps the list non-empty so a push never has to touch head.
+ */
+typedef struct {
+    _Atomic(queued_command *) tail; // Most recently pushed node
+    queued_command *head; // Oldest node not yet drained (consumer only)
+    queued_command stub; // Placeholder node that is never handed out
+} command_queue;
+
+/*
+ * One client's commands. Only that client's thread pushes to it, so the queue holds them
+ * in the order they were sent, which is also timestamp order.
+ */
+typedef struct command_source {
+    command_queue queue; // The client's commands, oldest first
+    atomic_bool closed; // Set once the client has disconnected and will push no more
+    struct command_source *next; // Next source in the inbox
+} command_source;
+
+/*
+ * Every client's command source. A drain merges the sources' FIFOs into one list in
+ * timestamp order with a min-heap keyed on each FIFO's oldest command, in O(n log clients).
+ */
+typedef struct {
+    pthread_mutex_t lock; // Guards the list of sources (held only to link one in or walk them)
+    command_source *sources; // Registered sources, newest first
+    queued_command **heap; // Drain scratch: the oldest undrained command of each source (consumer only)
+    size_t heap_capacity; // Entries allocated for heap
+} command_inbox;
+
+/*
+ * Initialises an empty command queue
+ */
+void command_queue_init(command_queue *q);
+
+/*
+ * Adds a new command to the end of the command queue (stores user info, command, its parsed form,
+ * client version and timestamp). Safe to call from any number of threads at once; wait-free.
+ */
+void enqueue_command(command_queue *q, const char *user, uint32_t user_id, const char *role, const char *cmd,
+                     const parsed_command *op, uint64_t version);
+
+/*
+ * Removes every command pushed so far and returns them in push order, linked through next
+ * (NULL if the queue is empty). A push still completing stays queued for the next drain.
+ * Must only be called by the single consumer.
+ */
+queued_command *command_queue_drain(command_queue *q);
 
 /*
- * Frees all memory in the command queue
+ * Frees all memory in a drained list of commands
  */
 void free_command_queue(queued_command **head);
 
 /*
- * Sorts the command queue by timestamp (earliest first) to ensure consistent processing order
- * Uses an in-place bubble sort by swapping fields
+ * Drains and frees every command still queued (no producer may be running)
+ */
+void command_queue_destroy(command_queue *q);
+
+/*
+ * Initialises an inbox with no sources
+ */
+void command_inbox_init(command_inbox *in);
+
+/*
+ * Registers a new client's command source
+ */
+command_source *command_inbox_open(command_inbox *in);
+
+/*
+ * Marks a source as finished. The inbox frees it once its remaining commands have been drained,
+ * so the caller must not use it afterwards.
+ */
+void command_source_close(command_source *source);
+
+/*
+ * Removes every command pushed to any source so far and returns them merged in timestamp
+ * order (earliest first), linked through next, or NULL if there are none. Sources closed
+ * before the drain began are freed. Must only be called by the single consumer.
+ */
+queued_command *command_inbox_drain(command_inbox *in);
+
+/*
+ * Frees every source and the commands still queued in them (no client may be running)
  */
-void sort_command_queue(queued_command **head);
+void command_inbox_destroy(command_inbox *in);
 
-#endif
\ No newline at end of file
+#endif
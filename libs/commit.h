@@ -0,0 +1,32 @@
+#ifndef COMMIT_H
+#define COMMIT_H
+
+#include "document.h"
+
+/*
+ * Sorts a list of edits by position in O(k log k).
+ * The sort is stable, so edits at the same position keep the order they were queued in.
+ */
+edit *commit_sort_edits(edit *list);
+
+/*
+ * Applies a sorted list of edits to the document in a single forward sweep.
+ * All positions refer to the document as it was before the commit: each run of chunks
+ * touched by the edits is rebuilt into densely packed chunks, merging the old content
+ * with inserted text and skipping deleted ranges. The edits themselves are not freed.
+ */
+void commit_edits(document *doc, edit *sorted);
+
+/*
+ * Rewrites the chunks covering positions [start, end] into densely packed chunks
+ * without changing the document's text
+ */
+void commit_repack(document *doc, size_t start, size_t end);
+
+/*
+ * Fills an empty document with the given text, packed directly into full chunks
+ * (used to restore a checkpoint without queueing an edit)
+ */
+void commit_load(document *doc, const char *data, size_t len);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stddef.h>
+#include "document.h"
+
+#define COMPACT_STEP_BUDGET 64 // Chunks visited by one incremental compaction step
+
+/*
+ * Runs one bounded compaction step: walks up to budget chunks from where the previous
+ * step stopped and repacks each run of adjacent underfull chunks into full ones.
+ * Wraps around to the start of the document when it reaches the end.
+ */
+void compact_step(document *doc, size_t budget);
+
+/*
+ * Reports the document's current fragmentation metrics (O(1))
+ */
+void compact_stats(const document *doc, fragmentation_stats *out);
+
+#endif
@@ -4,19 +4,115 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 
 #define CHUNK_SIZE 256 // Each chunk holds up to 256 characters of document content
+#define CACHE_LINE_SIZE 64 // Chunks are aligned to cache lines inside the pool's slabs
+#define UNDERFULL_CHUNK_LEN (CHUNK_SIZE / 2) // Chunks holding less than this are candidates for compaction
+#define NODES_PER_BLOCK 128 // Chunk tree nodes allocated together by the chunk pool
 
 /*
- * Represents a block of text in the document, forming a doubly linked list
+ * Represents a block of text in the document, forming a doubly linked list of the live
+ * document's chunks. Each linked chunk is held by one node of the chunk tree.
  */ 
 typedef struct chunk {
-    char data[CHUNK_SIZE]; // Buffer of characters in this chunk
+    _Alignas(CACHE_LINE_SIZE) char data[CHUNK_SIZE]; // Buffer of characters in this chunk
     size_t length; // Number of characters currently in use
     struct chunk *prev; // Pointer to previous chunk
     struct chunk *next; // Pointer to next chunk
+    size_t newlines; // Number of '\n' characters in this chunk
+    uint64_t hash; // Polynomial hash of this chunk's text (see chunk_tree_hash)
+    uint64_t retired_version; // Last version the chunk may be visible in (set when it is retired)
 } chunk;
 
+/*
+ * Node of the chunk tree, a balanced order-statistic tree (a treap keyed by document order)
+ * so a position can be located in O(log n) chunks. The tree is persistent: once a version has
+ * been published its nodes never change, and an update copies the nodes on its path instead,
+ * so every snapshot keeps a complete tree of its own that shares all untouched subtrees.
+ */
+typedef struct chunk_node {
+    struct chunk_node *left; // Subtree of chunks that come before this one
+    struct chunk_node *right; // Subtree of chunks that come after this one
+    chunk *chunk; // The chunk at this position
+    size_t subtree_length; // Total characters held by this node's subtree
+    size_t subtree_newlines; // Total '\n' characters held by this node's subtree
+    uint64_t subtree_hash; // Hash of this node's subtree's text in document order
+    uint64_t subtree_power; // DOC_HASH_BASE raised to subtree_length, for concatenating hashes
+    uint32_t priority; // Random heap priority keeping the tree balanced
+    uint64_t epoch; // Tree epoch the node was made in (it may change in place until that epoch is published)
+    uint64_t retired_version; // Last version the node may be visible in (set when it is retired)
+    struct chunk_node *link; // Next node in the pool's retired queue or free list
+} chunk_node;
+
+/*
+ * A block of chunk tree nodes, carved up by the chunk pool
+ */
+typedef struct chunk_node_block {
+    struct chunk_node_block *next; // Next block owned by the pool
+    chunk_node nodes[NODES_PER_BLOCK]; // The nodes themselves
+} chunk_node_block;
+
+/*
+ * A slab page of chunks. The header sits in the first cache line of the page and the
+ * page is aligned to its own size, so a chunk's slab is found by masking its address.
+ */
+typedef struct chunk_slab {
+    struct chunk_slab *prev; // Previous slab owned by the pool
+    struct chunk_slab *next; // Next slab owned by the pool
+    struct chunk_slab *avail_prev; // Previous slab with a free chunk
+    struct chunk_slab *avail_next; // Next slab with a free chunk
+    chunk *free_list; // Released chunks of this slab, linked through chunk->next
+    uint32_t in_use; // Chunks currently handed out from this slab
+    uint32_t carved; // Chunks handed out at least once (the rest have never been touched)
+} chunk_slab;
+
+/*
+ * Allocation counters kept by the chunk pool
+ */
+typedef struct {
+    size_t allocations; // Total chunks handed out
+    size_t frees; // Total chunks returned
+    size_t live_chunks; // Chunks currently in use
+    size_t slabs; // Slabs currently held
+    size_t slab_allocations; // Slabs requested from the system
+    size_t slab_releases; // Slabs given back to the system
+    size_t retired_chunks; // Unlinked chunks waiting until no snapshot can still see them
+    size_t live_nodes; // Chunk tree nodes currently in use (including retired ones)
+    size_t retired_nodes; // Replaced tree nodes waiting until no snapshot can still see them
+} chunk_pool_stats;
+
+/*
+ * Pool of chunk slabs owned by a document, with per-slab free lists.
+ * Empty slabs beyond a high watermark are returned to the system.
+ * The pool also hands out the chunk tree's nodes, which are kept on a free list for reuse.
+ */
+typedef struct {
+    chunk_slab *slabs; // Every slab owned by the pool
+    chunk_slab *available; // Slabs with at least one free chunk
+    size_t empty_slabs; // Slabs with no chunk in use
+    chunk *retired_head; // Oldest retired chunk, linked through chunk->next
+    chunk *retired_tail; // Most recently retired chunk
+    chunk_node_block *node_blocks; // Every block of tree nodes owned by the pool
+    chunk_node *free_nodes; // Released tree nodes, linked through chunk_node->link
+    chunk_node *retired_nodes_head; // Oldest retired tree node, linked through chunk_node->link
+    chunk_node *retired_nodes_tail; // Most recently retired tree node
+    bool defer_reclaim; // Keep retired chunks until reclaimed (set while snapshots are in use)
+    chunk_pool_stats stats; // Allocation counters
+} chunk_pool;
+
+/*
+ * Snapshot of how fragmented a document's chunk list is
+ */
+typedef struct {
+    size_t chunks; // Number of chunks
+    size_t underfull_chunks; // Chunks holding less than UNDERFULL_CHUNK_LEN characters
+    size_t bytes; // Characters stored
+    double fill_ratio; // bytes / (chunks * CHUNK_SIZE), 1.0 when perfectly packed
+    size_t compacted_chunks; // Chunks eliminated by compaction so far
+} fragmentation_stats;
+
 /*
  * Type of edit (insert or delete)
  */
@@ -42,9 +138,74 @@ typedef struct edit {
 typedef struct range {
     size_t start; // Starting index of deleted region
     size_t end; // Ending index (exclusive) of deleted region
-    struct range *next; // Pointer to next range
 } range;
 
+/*
+ * A block of memory owned by an arena; blocks are kept and reused after a reset
+ */
+typedef struct arena_block {
+    struct arena_block *next; // Next block in the arena
+    size_t size; // Usable bytes in data
+    size_t used; // Bytes handed out from data since the last reset
+    _Alignas(16) char data[]; // Storage for allocations
+} arena_block;
+
+/*
+ * Bump allocator whose allocations all live until the next reset
+ */
+typedef struct {
+    arena_block *first; // First block (allocation restarts here after a reset)
+    arena_block *current; // Block currently being bumped
+} arena;
+
+/*
+ * Sorted set of disjoint ranges, searched by binary search.
+ * Overlapping or touching ranges are merged as they are added.
+ */
+typedef struct {
+    range *items; // Ranges ordered by start
+    size_t count; // Number of ranges in use
+    size_t capacity; // Number of ranges allocated
+    arena *storage; // Arena the items array is allocated from
+} range_set;
+
+/*
+ * Kinds of line-level markdown blocks tracked by the block index
+ */
+typedef enum {
+    BLOCK_HEADING, // "# " to "### "
+    BLOCK_ORDERED_ITEM, // "1. " to "9. "
+    BLOCK_UNORDERED_ITEM, // "- "
+    BLOCK_BLOCKQUOTE, // "> "
+    BLOCK_HORIZONTAL_RULE, // A line holding exactly "---"
+    BLOCK_TYPE_COUNT
+} block_type;
+
+/*
+ * A line that starts a markdown block
+ */
+typedef struct {
+    size_t start; // Position of the first character of the line
+    int level; // Heading level or list item number (0 for the other types)
+} block;
+
+/*
+ * Blocks of one type, ordered by start position
+ */
+typedef struct {
+    block *items; // Blocks in document order
+    size_t count; // Number of blocks in use
+    size_t capacity; // Number of blocks allocated
+} block_list;
+
+/*
+ * Index of the document's block structure, kept current by every commit.
+ * Each type has its own list so "last ordered item before here" is a binary search.
+ */
+typedef struct {
+    block_list lists[BLOCK_TYPE_COUNT]; // One sorted list per block type
+} block_index;
+
 /*
  * Represents the entire document, including content and pending edits
  */
@@ -53,7 +214,55 @@ typedef struct {
     size_t length; // Total number of characters in the document
     chunk *head; // Pointer to the first chunk
     chunk *tail; // Pointer to the last chunk
+    chunk_node *root; // Root of the chunk tree (indexes the same chunks as head/tail)
+    uint64_t tree_epoch; // Nodes made in this epoch are not visible to any snapshot yet
+    uint32_t seed; // State of the generator for chunk tree priorities
+    size_t chunk_count; // Number of chunks linked into the document
+    size_t underfull_chunks; // Linked chunks holding less than UNDERFULL_CHUNK_LEN characters
+    size_t compact_pos; // Position the next incremental compaction step resumes from
+    size_t compacted_chunks; // Chunks eliminated by compaction so far
+    chunk_pool pool; // Allocator for this document's chunks
     edit *pending; // Linked list of pending edits
+    edit *pending_tail; // Last pending edit (for O(1) appends)
+    arena scratch; // Holds the pending edits, their text and scratch ranges until the next commit
+    range_set deleted; // Union of the ranges removed by pending deletes
+    block_index blocks; // Headings, list items, blockquotes and rules of the committed text
 } document;
 
+/*
+ * Immutable view of one committed version: the root of its chunk tree. The nodes and chunks
+ * are shared with the live document and later versions (neither is modified once published)
+ * and stay allocated while the snapshot is pinned.
+ */
+typedef struct snapshot {
+    uint64_t version; // Version the snapshot was taken at
+    size_t length; // Total number of characters
+    const chunk_node *root; // Root of the version's chunk tree
+    atomic_size_t refs; // Pins held by readers, plus one while this is the current snapshot
+    struct snapshot *prev; // Next older snapshot not yet freed (writer only)
+    struct snapshot *next; // Next newer snapshot not yet freed (writer only)
+} snapshot;
+
+/*
+ * Publishes snapshots of a document to readers that do not take the document lock.
+ * Readers never lock: they pin with atomic counters, and only the writer frees snapshots.
+ */
+typedef struct {
+    _Atomic(snapshot *) current; // Most recently published snapshot
+    _Atomic uint64_t current_version; // Its version, readable without pinning
+    atomic_size_t pinning; // Readers between loading current and taking their reference
+    snapshot *oldest; // Oldest snapshot not yet freed (writer only)
+    snapshot *newest; // Newest snapshot, the current one (writer only)
+} snapshot_store;
+
+/*
+ * Read-only position within a document that walks the chunks in place (no copying)
+ */
+typedef struct {
+    const document *doc; // Document being read
+    const chunk *chunk; // Chunk holding the current position (NULL at the end of the document)
+    size_t offset; // Offset of the current position within that chunk
+    size_t pos; // Absolute position in the document
+} doc_cursor;
+
 #endif
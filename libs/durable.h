@@ -0,0 +1,27 @@
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FNV32_OFFSET 2166136261u // Starting value of a checksum
+#define PATH_BUF_SIZE 256 // Buffer size for the paths of durable files and their directories
+
+/*
+ * Writes the whole buffer to a descriptor, retrying after short writes and interrupts.
+ * Returns 0 on success and -1 on failure.
+ */
+int durable_write_all(int fd, const void *data, size_t len);
+
+/*
+ * Continues a 32-bit FNV-1a checksum over data; start from FNV32_OFFSET. The journal and the
+ * checkpoint both checksum with it, so their formats cannot drift apart.
+ */
+uint32_t durable_checksum(uint32_t hash, const void *data, size_t len);
+
+/*
+ * Makes a file's creation, rename or removal durable by syncing the directory that holds path
+ */
+void durable_sync_parent_dir(const char *path);
+
+#endif
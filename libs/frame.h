@@ -0,0 +1,100 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "document.h"
+#include "byte_buffer.h"
+
+#define FRAME_BINARY_TOKEN "BINARY" // Ends the handshake of a client asking for frames; in the role line of a server
+                                  // agreeing it is followed by the client's user id
+#define FRAME_MAX_COMMAND_SIZE (UINT16_MAX - 256) // Longest command payload: journal records store command lengths in 16 bits,
+                                                  // less the LINE_LEN (256) bytes a rebase may add
+#define FRAME_MAX_PASTE_SIZE (16 * 1024 * 1024) // Longest text one paste may insert
+#define FRAME_PASTE_CHUNK_SIZE (16 * 1024) // Text carried by each FRAME_PASTE_DATA
+
+/*
+ * What a frame carries. Commands flow from client to server; a paste is streamed as a
+ * FRAME_PASTE_BEGIN, its text split over FRAME_PASTE_DATA frames, then a FRAME_PASTE_END.
+ * A broadcast block is a FRAME_VERSION, then each FRAME_EDIT result followed by the
+ * primitives it resolved to, then a FRAME_END.
+ */
+typedef enum {
+    FRAME_COMMAND = 1, // Editing command text
+    FRAME_DISCONNECT, // The client is leaving (no payload)
+    FRAME_RESYNC, // The RESYNC request or reply follows in its text form (no payload)
+    FRAME_VERSION, // Starts the block of a version; the payload is the 8-byte document hash
+    FRAME_EDIT, // "EDIT <user> <command> <result>" as logged
+    FRAME_INSERT, // A frame_span (len is the text's length), then the raw text
+    FRAME_DELETE, // A frame_span
+    FRAME_COMMIT, // Commits the primitives queued so far (no payload)
+    FRAME_END, // Ends a block (no payload)
+    FRAME_PASTE_BEGIN, // A frame_span: where the paste goes and its total length
+    FRAME_PASTE_DATA, // The next part of the pasted text
+    FRAME_PASTE_END // The whole text has been sent (no payload)
+} frame_opcode;
+
+/*
+ * Fixed header in front of every payload. FIFOs never leave the machine, so the fields are
+ * in host byte order and the header is copied in and out with memcpy.
+ */
+typedef struct {
+    uint32_t opcode; // A frame_opcode
+    uint32_t user_id; // Id of the client that sent the frame or whose command it reports (0 for the server's own)
+    uint64_t version; // Document version the frame refers to (0 if none)
+    uint32_t length; // Payload bytes following the header
+    uint32_t reserved; // Always 0
+} frame_header;
+
+/*
+ * Position and length of a primitive, at the start of FRAME_INSERT and FRAME_DELETE payloads
+ */
+typedef struct {
+    uint64_t pos; // Position in the document before the commit
+    uint64_t len; // Bytes inserted or deleted
+} frame_span;
+
+/*
+ * Appends one frame with the given payload (NULL if len is 0)
+ */
+void frame_append(byte_buffer *b, frame_opcode opcode, uint32_t user_id, uint64_t version, const void *payload, size_t len);
+
+/*
+ * Appends a list of pending edits as FRAME_INSERT and FRAME_DELETE frames in queue order,
+ * followed by FRAME_COMMIT if commit is set (the binary form of ops_format). Every frame
+ * carries the user id of the client whose command the edits came from.
+ */
+void frame_append_edits(byte_buffer *b, uint32_t user_id, const edit *first, bool commit);
+
+/*
+ * Writes one frame. Returns 0 on success, -1 if the write failed.
+ */
+int frame_write(int fd, frame_opcode opcode, uint32_t user_id, uint64_t version, const void *payload, size_t len);
+
+/*
+ * Writes a whole broadcast block (FRAME_VERSION with the hash, the encoded entries, FRAME_END)
+ * with a single writev. Returns 0 on success, -1 if the write failed.
+ */
+int frame_write_block(int fd, uint64_t version, uint64_t hash, const byte_buffer *entries);
+
+/*
+ * Reads one frame, growing *payload (null terminated) to fit. Returns false at end of file,
+ * on a short read, or if the payload is longer than max_len.
+ */
+bool frame_read(FILE *in, frame_header *h, char **payload, size_t *capacity, size_t max_len);
+
+/*
+ * Reads one frame whose payload goes straight into dest, which has room for max_len bytes
+ * (not null terminated). Returns false at end of file, on a short read, or if the payload
+ * is longer than max_len.
+ */
+bool frame_read_into(FILE *in, frame_header *h, char *dest, size_t max_len);
+
+/*
+ * Returns whether a frame has started to arrive, without blocking
+ */
+bool frame_poll(FILE *in);
+
+#endif
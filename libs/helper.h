@@ -3,6 +3,8 @@
 
 #include "markdown.h"
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 // Shared constants between server and client
 #define FIFO_NAME_LEN 64
@@ -10,7 +12,62 @@
 #define ROLE_LEN 16 // Role is either "read" or "write"
 #define MAX_COMMAND_SIZE 256 // Maximum command size is 256 bytes
 #define LINE_LEN 256
+#define UNAUTHORISED_ROLE -4 // A read-only user sent an edit
 #define UNKNOWN_COMMAND -5 // Fallback error code for unrecognised command
+#define CONFLICTING_EDIT -6 // Under --group-commit, the command touches text an earlier command of the tick edits
+
+/*
+ * Editing and formatting commands, identified by their keyword
+ */
+typedef enum {
+    CMD_UNKNOWN, // Not a well-formed command
+    CMD_INSERT, // INSERT <pos> <text>
+    CMD_DEL, // DEL <pos> <len>
+    CMD_NEWLINE, // NEWLINE <pos>
+    CMD_HEADING, // HEADING <level> <pos>
+    CMD_BOLD, // BOLD <start> <end>
+    CMD_ITALIC, // ITALIC <start> <end>
+    CMD_BLOCKQUOTE, // BLOCKQUOTE <pos>
+    CMD_ORDERED_LIST, // ORDERED_LIST <pos>
+    CMD_UNORDERED_LIST, // UNORDERED_LIST <pos>
+    CMD_CODE, // CODE <start> <end>
+    CMD_HORIZONTAL_RULE, // HORIZONTAL_RULE <pos>
+    CMD_LINK, // LINK <start> <end> <url>
+    CMD_PASTE // PASTE <pos> <len> <exactly len bytes, newlines included>
+} command_opcode;
+
+/*
+ * A command line parsed once into its opcode and arguments. Any trailing text (the text of an
+ * INSERT or the URL of a LINK) is kept as a slice of the line rather than copied.
+ */
+typedef struct {
+    command_opcode opcode; // CMD_UNKNOWN if the line did not parse
+    int level; // Heading level (HEADING only)
+    size_t pos; // Position, or start of a range
+    size_t arg; // Deletion or paste length (DEL, PASTE) or end of a range (BOLD, ITALIC, CODE, LINK)
+    size_t text_offset; // Offset of the trailing text within the line
+    size_t text_len; // Length of the trailing text (0 if the command has none)
+} parsed_command;
+
+/*
+ * Tokenizes a command line in one pass: the keyword is looked up in an opcode table and the
+ * arguments are read straight into the struct. Returns false (with opcode CMD_UNKNOWN) if the
+ * line is not a well-formed command.
+ */
+bool command_parse(const char *line, parsed_command *cmd);
+
+/*
+ * Applies a parsed command to the document. line is the text it was parsed from (its trailing
+ * text is read from there). Returns the markdown result code, or UNKNOWN_COMMAND.
+ */
+int command_execute(document *doc, const char *line, const parsed_command *cmd, uint64_t version);
+
+/*
+ * Writes the command back out as a line, using the (possibly changed) arguments in cmd and the
+ * trailing text from line. A paste is written as "PASTE <pos> <len>" without its bytes, which
+ * reach clients and the journal as primitives. Returns false if it does not fit in out_size bytes.
+ */
+bool command_format(const char *line, const parsed_command *cmd, char *out, size_t out_size);
 
 /*
  * Parses and applies a markdown editing command to the given document.
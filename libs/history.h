@@ -0,0 +1,88 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "server.h"
+
+#define HISTORY_SEGMENT_TICKS 64 // Broadcast blocks held by one segment
+#define HISTORY_DEFAULT_RETAINED_SEGMENTS 16 // Segments kept in memory unless configured otherwise
+#define HISTORY_SPILL_PATH "history.log" // File older segments are spilled to
+
+/*
+ * A fixed-size run of consecutive broadcast blocks (one per tick, in order)
+ */
+typedef struct {
+    version_log *ticks[HISTORY_SEGMENT_TICKS]; // Blocks in broadcast order
+    size_t count; // Blocks in use
+    size_t first_index; // Position of the first block in the whole history
+} log_segment;
+
+/*
+ * Location of a segment that was spilled to the history file
+ */
+typedef struct {
+    uint64_t first_version; // Version of the segment's first block
+    uint64_t last_version; // Version of the segment's last block
+    long offset; // Byte offset of the segment in the file
+    size_t length; // Bytes the segment occupies in the file
+    size_t first_index; // Position of the first block in the whole history
+} spilled_segment;
+
+/*
+ * Segmented history of broadcast blocks. Appends go to the newest segment in O(1);
+ * once more than retained_segments are in memory the oldest one is written to the
+ * spill file and freed. Versions never decrease, so both the in-memory segments and
+ * the spilled ones are indexed by binary search on version.
+ */
+typedef struct {
+    pthread_mutex_t lock; // Guards everything below (appends and LOG? queries run on different threads)
+    log_segment **segments; // In-memory segments, oldest first
+    size_t segment_count; // Segments in use
+    size_t segment_capacity; // Segments allocated
+    size_t retained_segments; // In-memory window before spilling
+    spilled_segment *spilled; // Index of spilled segments, oldest first
+    size_t spilled_count; // Entries in use
+    size_t spilled_capacity; // Entries allocated
+    const char *spill_path; // Path of the spill file
+    FILE *spill; // Spill file (opened on first spill)
+    size_t appended; // Blocks appended since the history began
+    uint64_t origin_version; // Document version before the oldest block still held
+} version_history;
+
+/*
+ * Initialises an empty history for a document currently at origin_version,
+ * keeping up to retained_segments segments in memory
+ */
+void history_init(version_history *h, uint64_t origin_version, size_t retained_segments, const char *spill_path);
+
+/*
+ * Appends the block broadcast for one tick; the history takes ownership of it
+ */
+void history_append(version_history *h, version_log *v);
+
+/*
+ * Prints every block with a version of at least from ("VERSION n", its lines, "END")
+ * among the first limit blocks appended, reading spilled segments back from disk as needed
+ */
+void history_print(version_history *h, uint64_t from, size_t limit, FILE *out);
+
+/*
+ * Returns the number of blocks appended so far (a limit for history_print)
+ */
+size_t history_length(version_history *h);
+
+/*
+ * Returns true if every block after the given version is still held, so a reader
+ * at that version can be brought up to date from the history alone
+ */
+bool history_covers(version_history *h, uint64_t version);
+
+/*
+ * Frees every segment and removes the spill file
+ */
+void history_free(version_history *h);
+
+#endif
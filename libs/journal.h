@@ -0,0 +1,95 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "document.h"
+
+#define JOURNAL_PATH "doc.journal" // Journal file kept next to doc.md
+#define JOURNAL_RETIRED_PATH "doc.journal.old" // Records a checkpoint in progress will cover (see journal_rotate)
+#define JOURNAL_INITIAL_CAPACITY 4096 // First allocation for the batch buffer
+
+/*
+ * Kinds of journal record
+ */
+typedef enum {
+    JOURNAL_COMMAND = 1, // A successful command, replayed through process_command
+    JOURNAL_OPS = 2 // A successful command followed by its resolved primitives (ops_format), replayed with ops_apply.
+                    // In group-commit mode the primitives carry no OPS_COMMIT_LINE; a final record holding
+                    // only that line (and no user or command) commits the whole tick.
+} journal_record_kind;
+
+/*
+ * Fixed-size header in front of every journal record. The checksum covers the rest of
+ * the header and the payload, so a record torn by a crash is detected on recovery.
+ */
+typedef struct {
+    uint32_t checksum; // FNV-1a over everything after this field
+    uint32_t payload_len; // Bytes following the header (user_len + command_len, plus the primitives for JOURNAL_OPS)
+    uint64_t version; // Document version produced by the record
+    uint16_t kind; // journal_record_kind
+    uint16_t user_len; // Length of the username (not null terminated)
+    uint16_t command_len; // Length of the command (not null terminated)
+    uint16_t reserved; // Always zero
+} journal_record_header;
+
+/*
+ * Append-only journal. Records are buffered for the current broadcast tick and
+ * made durable together by journal_flush.
+ */
+typedef struct {
+    int fd; // Journal file (opened for appending)
+    size_t size; // Bytes of whole records durable in the file
+    char *buf; // Records appended since the last flush
+    size_t len; // Bytes used in buf
+    size_t capacity; // Bytes allocated for buf
+} journal;
+
+/*
+ * Opens (or creates) the journal for appending. Returns false on failure.
+ */
+bool journal_open(journal *j, const char *path);
+
+/*
+ * Buffers one record for a successful command; nothing is written until journal_flush.
+ * If ops (the command's resolved primitives) is given the record is JOURNAL_OPS and recovery
+ * replays the primitives instead of re-running the command.
+ */
+void journal_append(journal *j, uint64_t version, const char *user, const char *command, const char *ops);
+
+/*
+ * Writes every buffered record with a single write and makes it durable with fdatasync.
+ * Returns 0 on success and -1 on failure. A failed flush cuts the file back to its last whole
+ * record and keeps the records buffered, so a later flush can retry them.
+ */
+int journal_flush(journal *j);
+
+/*
+ * Flushes any buffered records and closes the journal
+ */
+void journal_close(journal *j);
+
+/*
+ * Discards every record in the journal (called once a checkpoint covers them).
+ * Returns 0 on success and -1 on failure.
+ */
+int journal_truncate(journal *j);
+
+/*
+ * Renames the journal file at path to retired_path and carries on in a new, empty file at
+ * path, so the records up to now can be dropped as a whole once a checkpoint covers them.
+ * Returns 0 on success and -1 on failure (the journal is then left as it was).
+ */
+int journal_rotate(journal *j, const char *path, const char *retired_path);
+
+/*
+ * Replays the journal at path into a document, committing one version per record (or per group
+ * of records ending in a commit). Records at or below the document's current version (already
+ * covered by a checkpoint) are skipped. Stops at the first torn or corrupt record and truncates
+ * the file there, or at the start of a group whose commit never made it to disk.
+ * Returns the number of records applied (0 if there is no journal), or -1 on error.
+ */
+long journal_replay(const char *path, document *doc);
+
+#endif
@@ -33,7 +33,21 @@ int markdown_link(document *doc, uint64_t version, size_t start, size_t end, con
 // === Utilities ===
 void markdown_print(const document *doc, FILE *stream);
 char *markdown_flatten(const document *doc);
+void markdown_outline(const document *doc, FILE *stream);
+
+// === Cursor (zero-copy reads over chunks) ===
+void markdown_cursor_seek(doc_cursor *cur, const document *doc, size_t pos);
+int markdown_cursor_peek(const doc_cursor *cur);
+int markdown_cursor_next(doc_cursor *cur);
+int markdown_cursor_prev(doc_cursor *cur);
+size_t markdown_cursor_span(doc_cursor *cur, const char **data);
+
+// === Line Queries (O(log n), no flattening) ===
+int markdown_char_at(const document *doc, size_t pos);
+size_t markdown_line_start(const document *doc, size_t pos);
+size_t markdown_next_line_start(const document *doc, size_t pos);
 
 // === Versioning ===
 void markdown_increment_version(document *doc);
+void markdown_discard_pending(document *doc, edit *mark);
 #endif // MARKDOWN_H
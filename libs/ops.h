@@ -0,0 +1,35 @@
+#ifndef OPS_H
+#define OPS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "markdown.h"
+
+#define OPS_PREFIX "OP " // Every primitive line starts with this
+#define OPS_PREFIX_LEN 3 // strlen(OPS_PREFIX)
+#define OPS_COMMIT_LINE "OP C" // Ends the primitives of one command; the receiver commits there
+
+/*
+ * Formats a list of pending edits (the resolved primitives of the command that queued them)
+ * as one line each, followed by OPS_COMMIT_LINE if commit is set:
+ *   "OP I <pos> <len> <text>" inserts len bytes; '\', newlines and other non-printable
+ *                             bytes in text are escaped so the line never breaks
+ *   "OP D <pos> <len>"        deletes len bytes
+ * Positions refer to the document before the commit, as for the edits themselves.
+ * Lines are separated by '\n' with no trailing newline. Returns a string the caller frees.
+ */
+char *ops_format(const edit *first, bool commit);
+
+/*
+ * Applies one primitive line: inserts and deletes are queued, OPS_COMMIT_LINE commits them.
+ * Returns SUCCESS, or INVALID_CURSOR_POS if the line is malformed or out of range.
+ */
+int ops_apply_line(document *doc, const char *line);
+
+/*
+ * Applies a block of '\n'-separated primitive lines as produced by ops_format.
+ * Returns SUCCESS, or INVALID_CURSOR_POS at the first line that does not apply.
+ */
+int ops_apply(document *doc, const char *ops, size_t len);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef RANGE_SET_H
+#define RANGE_SET_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "document.h"
+
+/*
+ * Initialises an empty set whose storage is allocated from the given arena
+ */
+void range_set_init(range_set *set, arena *storage);
+
+/*
+ * Removes every range in O(1) (call when the backing arena is reset, as the storage goes with it)
+ */
+void range_set_clear(range_set *set);
+
+/*
+ * Adds [start, end) to the set, merging it with any ranges it overlaps or touches
+ */
+void range_set_add(range_set *set, size_t start, size_t end);
+
+/*
+ * Returns the last range starting at or before pos, or NULL if there is none (O(log n))
+ */
+const range *range_set_floor(const range_set *set, size_t pos);
+
+/*
+ * Returns the range containing pos (start <= pos < end), or NULL if pos is not covered (O(log n))
+ */
+const range *range_set_containing(const range_set *set, size_t pos);
+
+/*
+ * Returns whether any position in [start, end) is covered by the set (O(log n))
+ */
+bool range_set_overlaps(const range_set *set, size_t start, size_t end);
+
+#endif
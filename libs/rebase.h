@@ -0,0 +1,69 @@
+#ifndef REBASE_H
+#define REBASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "markdown.h"
+#include "helper.h"
+
+#define REBASE_WINDOW_VERSIONS 1024 // Most recent commits a stale command can be rebased across
+
+/*
+ * One primitive of a commit: an insert of len bytes at pos, or a deleted range [pos, pos + len).
+ * Positions refer to the document before the commit.
+ */
+typedef struct {
+    size_t pos; // Position the insert or deletion starts at
+    size_t len; // Bytes inserted or deleted
+} rebase_span;
+
+/*
+ * Primitives of one committed version. Deletes are clamped to the document and merged,
+ * so no two overlap; both lists are sorted by position.
+ */
+typedef struct {
+    rebase_span *spans; // Inserts first, then deletes
+    size_t inserts; // Number of inserts
+    size_t deletes; // Number of deletes
+    size_t length_before; // Document length before the commit
+} rebase_commit;
+
+/*
+ * Ring of the primitives committed by the most recent versions
+ */
+typedef struct {
+    rebase_commit *commits; // Slot for version v is v % capacity
+    size_t capacity; // Versions held
+    uint64_t origin_version; // Version before the oldest commit held
+    uint64_t last_version; // Version produced by the newest commit held
+} rebase_log;
+
+/*
+ * Initialises an empty log for a document currently at the given version
+ */
+void rebase_log_init(rebase_log *log, uint64_t version, size_t capacity);
+
+/*
+ * Records the pending edits of the document as the commit producing doc->version + 1.
+ * Call just before markdown_increment_version.
+ */
+void rebase_log_record(rebase_log *log, const document *doc);
+
+/*
+ * Moves the positions of a command issued against an older version so they refer to the given
+ * current version, transforming them across every commit in between. Concurrent inserts at
+ * the same position are kept before the command's own text, a position inside deleted text
+ * moves to where the deletion was, and ranges shrink around deleted text.
+ * Updates cmd in place and returns SUCCESS, DELETED_POSITION if every character of its range
+ * was deleted in the meantime, INVALID_CURSOR_POS if it was out of range at its own version,
+ * or OUTDATED_VERSION if the log no longer reaches back that far.
+ * Unknown commands are left unchanged.
+ */
+int rebase_command(const rebase_log *log, parsed_command *cmd, uint64_t version, uint64_t current_version);
+
+/*
+ * Frees every commit held
+ */
+void rebase_log_free(rebase_log *log);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef RESYNC_H
+#define RESYNC_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "document.h"
+
+#define RESYNC_BLOCK_SIZE (4 * CHUNK_SIZE) // Block size clients sign their copy with
+#define RESYNC_MIN_BLOCK_SIZE CHUNK_SIZE // Smallest block size the server accepts
+#define RESYNC_MAX_BLOCK_SIZE (64 * 1024) // Largest block size the server accepts
+#define RESYNC_MAX_BASIS_LEN ((size_t)1 << 30) // Longest client copy the server will read a signature for
+#define RESYNC_END_LINE "RESYNC_END\n" // Terminates the list of operations in a reply
+
+/*
+ * Signature of one block of the client's copy. The weak sum can be rolled one byte at a
+ * time, so the server finds blocks at any offset; the strong hash confirms a match.
+ */
+typedef struct {
+    uint32_t weak; // rsync-style rolling checksum
+    uint64_t strong; // 64-bit FNV-1a
+} resync_block;
+
+/*
+ * Bytes a reply reused from the client's copy versus sent literally
+ */
+typedef struct {
+    size_t copied; // Bytes rebuilt from the client's own blocks
+    size_t literal; // Bytes sent over the FIFO
+} resync_stats;
+
+/*
+ * Writes the request "RESYNC <block_size> <len>" followed by one "<weak> <strong>" line per
+ * block of data (the last block may be short)
+ */
+void resync_send_signature(FILE *out, const char *data, size_t len, size_t block_size);
+
+/*
+ * Reads the block signature lines of a request for a copy of len bytes (block_size is not 0).
+ * Every announced line is consumed, even when the request is rejected, so the lines after it
+ * stay in step. Returns an array of blocks (caller frees), or NULL if the signature is
+ * malformed or ends early, the block size is outside RESYNC_MIN_BLOCK_SIZE to
+ * RESYNC_MAX_BLOCK_SIZE, len is over RESYNC_MAX_BASIS_LEN or the array cannot be allocated.
+ */
+resync_block *resync_read_signature(FILE *in, size_t len, size_t block_size);
+
+/*
+ * Writes the operations that turn the client's copy (described by its signature) into data:
+ * "COPY <first block> <block count>" for runs the client already has and "DATA <len>"
+ * followed by the raw bytes for everything else, then RESYNC_END_LINE
+ */
+void resync_diff(const char *data, size_t len, const resync_block *blocks, size_t basis_len,
+                 size_t block_size, FILE *out, resync_stats *stats);
+
+/*
+ * Rebuilds a text of length bytes from the client's copy (basis) and the operations read from in.
+ * The reply is read up to RESYNC_END_LINE even if an operation is malformed.
+ * Returns the new text (caller frees) or NULL if the operations are malformed.
+ */
+char *resync_apply(FILE *in, const char *basis, size_t basis_len, size_t block_size,
+                   size_t length, resync_stats *stats);
+
+#endif
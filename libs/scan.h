@@ -0,0 +1,38 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Instruction set levels a scanning kernel can be built for
+ */
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+} scan_level;
+
+/*
+ * Table of byte-scanning kernels for one instruction set level
+ */
+typedef struct {
+    scan_level level; // Level these kernels were built for
+    const char *name; // Human readable level name
+    const char *(*find_newline)(const char *data, size_t len); // First '\n', or NULL
+    const char *(*find_last_newline)(const char *data, size_t len); // Last '\n', or NULL
+    size_t (*count_newlines)(const char *data, size_t len); // Number of '\n'
+    const char *(*find_list_prefix)(const char *data, size_t len); // First "<digit>. " fully inside the span, or NULL
+    size_t (*find_non_printable)(const char *data, size_t len); // Index of the first byte outside 32-126, or len
+} scan_kernels;
+
+/*
+ * Returns the kernels for a given level, or NULL if this CPU (or build) does not support it
+ */
+const scan_kernels *scan_get_kernels(scan_level level);
+
+/*
+ * Kernels for the best level the running CPU supports (selected once at startup)
+ */
+extern const scan_kernels *scan;
+
+#endif
@@ -1,5 +1,9 @@
+#ifndef SERVER_H
+#define SERVER_H
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <signal.h>
 #include <pthread.h>
@@ -7,6 +11,9 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <stdbool.h>
+
+#include "document.h"
 
 /*
  * Holds the PID of a newly connecting client (passed to handler thread)
@@ -28,9 +35,9 @@ typedef struct log_entry {
  *A complete log of one document version's changes
  */ 
 typedef struct version_log {
-    int version_number; // Version number associated with changes
+    uint64_t version_number; // Version number associated with changes
+    uint64_t doc_hash; // Hash of the document text at this version (chunk_tree_hash)
     log_entry *entries; // Linked list of log entries for this version
-    struct version_log *next; // Pointer to next log version
 } version_log;
 
 /*
@@ -38,5 +45,30 @@ typedef struct version_log {
  */ 
 typedef struct client_pipe {
     int fd; // File descriptor for the server-to-client FIFO
+    bool binary; // Receives broadcasts as frames instead of text lines (negotiated in the handshake)
+    uint32_t user_id; // Numeric id of this connection, carried in the frames of its commands
+    pthread_mutex_t write_lock; // Keeps broadcasts from interleaving with the initial document sync
     struct client_pipe *next; // Pointer to next client in the list
-} client_pipe;
\ No newline at end of file
+} client_pipe;
+
+/*
+ * Outcome of reading one message from a client
+ */
+typedef enum {
+    READ_COMMAND, // A well-formed command is in the line buffer
+    READ_INVALID, // A whole message was read but is not a valid command; the session goes on
+    READ_CLOSED // The client has gone or broke the framing, so nothing more can be read
+} read_status;
+
+/*
+ * The edits accepted so far in a --group-commit tick, in the committed text's positions, indexed
+ * so each new edit is checked for conflicts in O(log n). Emptied when the tick commits.
+ */
+typedef struct {
+    arena storage; // Backs the three sets below
+    range_set inserts; // [pos, pos + 1) for every insertion
+    range_set deletes; // Union of the deleted ranges
+    range_set interiors; // Positions strictly inside a deleted range: [start + 1, end)
+} tick_index;
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "document.h"
+
+/*
+ * Starts publishing snapshots of the document. Retired chunks are kept from now on
+ * until no pinned snapshot can see them. Publishes the document's current version.
+ */
+void snapshot_store_init(snapshot_store *store, document *doc);
+
+/*
+ * Frees every snapshot still held by the store (the nodes and chunks belong to the document's pool)
+ */
+void snapshot_store_destroy(snapshot_store *store);
+
+/*
+ * Publishes the document's committed state as the current snapshot and reclaims the
+ * chunks and tree nodes no live snapshot can see any more. Must be called by the writer
+ * after a commit. The snapshot shares the document's whole tree, so publishing is O(1);
+ * the commits since the last publish already copied the O(log n) nodes they changed.
+ */
+void snapshot_publish(snapshot_store *store, document *doc);
+
+/*
+ * Frees snapshots readers have released, and the retired chunks and tree nodes only they
+ * could see. Must be called by the writer.
+ */
+void snapshot_reclaim(snapshot_store *store, document *doc);
+
+/*
+ * Pins the current snapshot so it stays valid until released. Lock-free: never waits for
+ * the writer or other readers.
+ */
+snapshot *snapshot_pin(snapshot_store *store);
+
+/*
+ * Drops a pin taken with snapshot_pin (the writer frees the snapshot once it is unused)
+ */
+void snapshot_release(snapshot *snap);
+
+/*
+ * Returns the version of the current snapshot without pinning it
+ */
+uint64_t snapshot_current_version(snapshot_store *store);
+
+/*
+ * Writes the snapshot's text to a stream
+ */
+void snapshot_print(const snapshot *snap, FILE *stream);
+
+/*
+ * Writes the snapshot's text to a file descriptor
+ */
+void snapshot_write(const snapshot *snap, int fd);
+
+/*
+ * Copies the snapshot's text into a new null-terminated buffer (caller frees)
+ */
+char *snapshot_flatten(const snapshot *snap);
+
+#endif
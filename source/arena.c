@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libs/arena.h"
+
+#define ARENA_ALIGN 16 // Every allocation is aligned for any edit or range struct
+
+// HELPER FUNCTIONS
+
+// Rounds a size up to the arena alignment
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// Allocates a block big enough for at least min_size bytes
+static arena_block *new_block(size_t min_size) {
+    size_t size = (min_size > ARENA_BLOCK_SIZE) ? align_up(min_size) : ARENA_BLOCK_SIZE;
+    arena_block *b = malloc(sizeof(arena_block) + size);
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+// ARENA OPERATIONS
+
+// Starts with no blocks
+void arena_init(arena *a) {
+    a->first = NULL;
+    a->current = NULL;
+}
+
+// Walks the block list, freeing every block
+void arena_destroy(arena *a) {
+    arena_block *b = a->first;
+    while (b) {
+        arena_block *next = b->next;
+        free(b);
+        b = next;
+    }
+    arena_init(a);
+}
+
+// Bumps the current block, moving on to (or creating) a later block when it is full
+void *arena_alloc(arena *a, size_t size) {
+    size = align_up(size);
+    if (!a->current) {
+        a->first = a->current = new_block(size);
+    }
+    while (a->current->size - a->current->used < size) {
+        arena_block *next = a->current->next;
+        if (!next || next->size < size) {
+            // Splice a fresh block in front of any smaller retained ones
+            arena_block *b = new_block(size);
+            b->next = next;
+            a->current->next = b;
+            next = b;
+        }
+        next->used = 0;
+        a->current = next;
+    }
+    void *ptr = a->current->data + a->current->used;
+    a->current->used += size;
+    return ptr;
+}
+
+// Copies the string including its null terminator
+char *arena_strdup(arena *a, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = arena_alloc(a, len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+// Frees oversized blocks so one large paste does not stay pinned to the arena. Only the first
+// kept block needs rewinding; later ones are rewound as allocation reaches them.
+void arena_reset(arena *a) {
+    arena_block **link = &a->first;
+    while (*link) {
+        arena_block *b = *link;
+        if (b->size > ARENA_BLOCK_SIZE) {
+            *link = b->next;
+            free(b);
+        } else {
+            link = &b->next;
+        }
+    }
+    if (a->first) {
+        a->first->used = 0;
+    }
+    a->current = a->first;
+}
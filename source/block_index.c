@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../libs/block_index.h"
+#include "../libs/chunk_tree.h"
+#include "../libs/scan.h"
+
+#define BLOCK_PEEK_LEN 4 // Longest marker needed to classify a line ("### " or "---\n")
+#define MAX_BLOCK_HEADING_LEVEL 3 // Headings go up to ###
+#define INITIAL_BLOCK_CAPACITY 16 // First allocation for a block list
+
+// HELPER FUNCTIONS
+
+// Returns the index of the first block starting at or after pos
+static size_t lower_bound(const block_list *list, size_t pos) {
+    size_t lo = 0;
+    size_t hi = list->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (list->items[mid].start < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Inserts a block at index i, growing the list if needed
+static void list_insert(block_list *list, size_t i, block b) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : INITIAL_BLOCK_CAPACITY;
+        list->items = realloc(list->items, list->capacity * sizeof(block));
+    }
+    memmove(&list->items[i + 1], &list->items[i], (list->count - i) * sizeof(block));
+    list->items[i] = b;
+    list->count++;
+}
+
+// Copies up to BLOCK_PEEK_LEN characters starting at the given chunk offset, crossing chunk boundaries
+static size_t peek(const chunk *c, size_t offset, char *out) {
+    size_t n = 0;
+    while (c && n < BLOCK_PEEK_LEN) {
+        if (offset < c->length) {
+            out[n++] = c->data[offset++];
+        } else {
+            c = c->next;
+            offset = 0;
+        }
+    }
+    return n;
+}
+
+// Classifies a line from its first n characters; returns false for plain text
+static bool classify_line(const char *w, size_t n, block_type *type, int *level) {
+    size_t hashes = 0;
+    while (hashes < n && hashes < MAX_BLOCK_HEADING_LEVEL && w[hashes] == '#') {
+        hashes++;
+    }
+    if (hashes > 0 && hashes < n && w[hashes] == ' ') {
+        *type = BLOCK_HEADING;
+        *level = (int)hashes;
+        return true;
+    }
+    if (n >= 3 && w[0] >= '0' && w[0] <= '9' && w[1] == '.' && w[2] == ' ') {
+        *type = BLOCK_ORDERED_ITEM;
+        *level = w[0] - '0';
+        return true;
+    }
+    if (n >= 2 && w[1] == ' ' && (w[0] == '-' || w[0] == '>')) {
+        *type = (w[0] == '-') ? BLOCK_UNORDERED_ITEM : BLOCK_BLOCKQUOTE;
+        *level = 0;
+        return true;
+    }
+    if (n >= 3 && memcmp(w, "---", 3) == 0 && (n == 3 || w[3] == '\n')) {
+        *type = BLOCK_HORIZONTAL_RULE;
+        *level = 0;
+        return true;
+    }
+    return false;
+}
+
+// INDEX OPERATIONS
+
+// Starts with every list empty
+void block_index_init(block_index *idx) {
+    for (int t = 0; t < BLOCK_TYPE_COUNT; t++) {
+        idx->lists[t] = (block_list){ NULL, 0, 0 };
+    }
+}
+
+// Releases the lists and leaves the index empty
+void block_index_free(block_index *idx) {
+    for (int t = 0; t < BLOCK_TYPE_COUNT; t++) {
+        free(idx->lists[t].items);
+    }
+    block_index_init(idx);
+}
+
+// Drops the blocks of the rewritten lines, shifts the rest and rescans only the new region
+void block_index_update(document *doc, size_t start, size_t old_end, size_t new_end) {
+    block_index *idx = &doc->blocks;
+    long long change = (long long)new_end - (long long)old_end;
+
+    // The line holding start may change kind even though it begins before the edit
+    size_t before = chunk_tree_newlines_before(doc, start);
+    size_t from = before ? chunk_tree_find_newline(doc, before - 1) + 1 : 0;
+
+    size_t insert_at[BLOCK_TYPE_COUNT];
+    for (int t = 0; t < BLOCK_TYPE_COUNT; t++) {
+        block_list *list = &idx->lists[t];
+        size_t lo = lower_bound(list, from);
+        size_t hi = lower_bound(list, old_end + 1);
+        if (hi > lo) {
+            memmove(&list->items[lo], &list->items[hi], (list->count - hi) * sizeof(block));
+            list->count -= hi - lo;
+        }
+        for (size_t i = lo; i < list->count; i++) {
+            list->items[i].start = (size_t)((long long)list->items[i].start + change);
+        }
+        insert_at[t] = lo;
+    }
+
+    // Walk the lines starting in [from, new_end], hopping between newlines with the scan kernel
+    size_t offset;
+    const chunk *c = chunk_tree_find(doc, from, &offset);
+    size_t pos = from;
+    while (c && pos <= new_end) {
+        char window[BLOCK_PEEK_LEN];
+        size_t n = peek(c, offset, window);
+        block_type type;
+        int level;
+        if (classify_line(window, n, &type, &level)) {
+            list_insert(&idx->lists[type], insert_at[type]++, (block){ pos, level });
+        }
+
+        const char *nl = NULL;
+        while (c && (nl = scan->find_newline(c->data + offset, c->length - offset)) == NULL) {
+            pos += c->length - offset;
+            c = c->next;
+            offset = 0;
+        }
+        if (!c) {
+            break;
+        }
+        size_t skip = (size_t)(nl - (c->data + offset)) + 1;
+        pos += skip;
+        offset += skip;
+        if (offset == c->length) {
+            c = c->next;
+            offset = 0;
+        }
+    }
+}
+
+// QUERIES
+
+// Binary search for an exact start position
+const block *block_index_at(const block_index *idx, block_type type, size_t pos) {
+    const block_list *list = &idx->lists[type];
+    size_t i = lower_bound(list, pos);
+    return (i < list->count && list->items[i].start == pos) ? &list->items[i] : NULL;
+}
+
+// Binary search for the first block after pos, then steps back one
+const block *block_index_last_before(const block_index *idx, block_type type, size_t pos) {
+    const block_list *list = &idx->lists[type];
+    size_t i = lower_bound(list, pos + 1);
+    return (i > 0) ? &list->items[i - 1] : NULL;
+}
+
+// Maps block types to the command names used elsewhere in the protocol
+const char *block_type_name(block_type type) {
+    static const char *names[BLOCK_TYPE_COUNT] = {
+        "HEADING", "ORDERED_LIST", "UNORDERED_LIST", "BLOCKQUOTE", "HORIZONTAL_RULE"
+    };
+    return names[type];
+}
@@ -0,0 +1,38 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libs/byte_buffer.h"
+
+#define BYTE_BUFFER_MIN 256 // First allocation of a buffer
+
+// BUFFER OPERATIONS
+
+// Doubles the capacity until it covers the request, so appends cost amortised O(1)
+void byte_buffer_reserve(byte_buffer *b, size_t extra) {
+    if (b->len + extra <= b->capacity) {
+        return;
+    }
+    size_t capacity = b->capacity ? b->capacity : BYTE_BUFFER_MIN;
+    while (capacity < b->len + extra) {
+        capacity *= 2;
+    }
+    b->data = realloc(b->data, capacity);
+    b->capacity = capacity;
+}
+
+// Reserves first so the copy lands in place
+void byte_buffer_append(byte_buffer *b, const void *data, size_t len) {
+    byte_buffer_reserve(b, len);
+    if (len > 0) {
+        memcpy(b->data + b->len, data, len);
+    }
+    b->len += len;
+}
+
+// Releases the allocation; the buffer can be used again afterwards
+void byte_buffer_free(byte_buffer *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = 0;
+    b->capacity = 0;
+}
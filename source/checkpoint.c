@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../libs/checkpoint.h"
+#include "../libs/chunk_tree.h"
+#include "../libs/commit.h"
+#include "../libs/durable.h"
+
+#define TEMP_SUFFIX ".tmp"
+
+_Static_assert(sizeof(checkpoint_header) == 32, "checkpoint header must not contain padding");
+
+// CHECKPOINTS
+
+// Chunk contents are written back to back, so the image is exactly the document text
+int checkpoint_write(const snapshot *snap, const char *path) {
+    char tmp[PATH_BUF_SIZE];
+    snprintf(tmp, sizeof(tmp), "%s%s", path, TEMP_SUFFIX);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("open checkpoint");
+        return -1;
+    }
+
+    checkpoint_header h;
+    memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+    h.format = CHECKPOINT_FORMAT;
+    h.version = snap->version;
+    h.length = snap->length;
+    h.checksum = FNV32_OFFSET;
+    chunk_iter it;
+    chunk_iter_init(&it, snap->root);
+    for (const chunk *c; (c = chunk_iter_next(&it)) != NULL; ) {
+        h.checksum = durable_checksum(h.checksum, c->data, c->length);
+    }
+    chunk_iter_free(&it);
+    h.reserved = 0;
+
+    int result = durable_write_all(fd, &h, sizeof(h));
+    chunk_iter_init(&it, snap->root);
+    for (const chunk *c; result == 0 && (c = chunk_iter_next(&it)) != NULL; ) {
+        result = durable_write_all(fd, c->data, c->length);
+    }
+    chunk_iter_free(&it);
+    if (result == 0) {
+        result = fsync(fd);
+    }
+    close(fd);
+    if (result == 0) {
+        result = rename(tmp, path);
+    }
+    if (result != 0) {
+        perror("write checkpoint");
+        unlink(tmp);
+        return -1;
+    }
+    durable_sync_parent_dir(path);
+    return 0;
+}
+
+// Validates the mapped image and bulk-loads its text without going through the edit queue
+int checkpoint_load(document *doc, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(checkpoint_header)) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    const char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    madvise((void *)base, size, MADV_SEQUENTIAL);
+
+    checkpoint_header h;
+    memcpy(&h, base, sizeof(h));
+    const char *text = base + sizeof(h);
+    int result = -1;
+    if (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) == 0 &&
+        h.format == CHECKPOINT_FORMAT &&
+        h.length == size - sizeof(h) &&
+        durable_checksum(FNV32_OFFSET, text, h.length) == h.checksum) {
+        commit_load(doc, text, h.length);
+        doc->version = h.version;
+        result = 1;
+    }
+
+    munmap((void *)base, size);
+    return result;
+}
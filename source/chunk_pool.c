@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../libs/chunk_pool.h"
+
+// The slab header is padded to a cache line so the chunks after it stay aligned
+#define SLAB_HEADER_SIZE (((sizeof(chunk_slab) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE)
+#define CHUNKS_PER_SLAB ((SLAB_SIZE - SLAB_HEADER_SIZE) / sizeof(chunk))
+
+_Static_assert((SLAB_SIZE & (SLAB_SIZE - 1)) == 0, "SLAB_SIZE must be a power of two");
+_Static_assert(CHUNKS_PER_SLAB > 0, "SLAB_SIZE is too small to hold a chunk");
+
+// HELPER FUNCTIONS
+
+// Finds the slab a chunk was carved from by masking off the low address bits
+static chunk_slab *slab_of(const chunk *c) {
+    return (chunk_slab *)((uintptr_t)c & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+// Returns the i-th chunk slot of a slab
+static chunk *slab_chunk(chunk_slab *s, size_t i) {
+    return (chunk *)((char *)s + SLAB_HEADER_SIZE) + i;
+}
+
+// Adds a slab to the front of the list of slabs with free chunks
+static void push_available(chunk_pool *pool, chunk_slab *s) {
+    s->avail_prev = NULL;
+    s->avail_next = pool->available;
+    if (pool->available) {
+        pool->available->avail_prev = s;
+    }
+    pool->available = s;
+}
+
+// Removes a slab from the list of slabs with free chunks
+static void remove_available(chunk_pool *pool, chunk_slab *s) {
+    if (s->avail_prev) {
+        s->avail_prev->avail_next = s->avail_next;
+    } else {
+        pool->available = s->avail_next;
+    }
+    if (s->avail_next) {
+        s->avail_next->avail_prev = s->avail_prev;
+    }
+    s->avail_prev = s->avail_next = NULL;
+}
+
+// Stops the process when the system has no memory for a slab or node block. A commit has
+// already started rewriting the document by then and cannot be rolled back halfway.
+static void out_of_memory(const char *what) {
+    perror(what);
+    abort();
+}
+
+// Requests a new slab page from the system and registers it with the pool
+static chunk_slab *new_slab(chunk_pool *pool) {
+    chunk_slab *s = aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+    if (!s) {
+        out_of_memory("chunk_pool slab");
+    }
+    s->free_list = NULL;
+    s->in_use = 0;
+    s->carved = 0;
+
+    s->prev = NULL;
+    s->next = pool->slabs;
+    if (pool->slabs) {
+        pool->slabs->prev = s;
+    }
+    pool->slabs = s;
+    push_available(pool, s);
+
+    pool->empty_slabs++;
+    pool->stats.slabs++;
+    pool->stats.slab_allocations++;
+    return s;
+}
+
+// Gives an empty slab back to the system
+static void release_slab(chunk_pool *pool, chunk_slab *s) {
+    remove_available(pool, s);
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        pool->slabs = s->next;
+    }
+    if (s->next) {
+        s->next->prev = s->prev;
+    }
+    free(s);
+
+    pool->empty_slabs--;
+    pool->stats.slabs--;
+    pool->stats.slab_releases++;
+}
+
+// POOL OPERATIONS
+
+// Starts with no slabs; they are created on demand
+void chunk_pool_init(chunk_pool *pool) {
+    pool->slabs = NULL;
+    pool->available = NULL;
+    pool->empty_slabs = 0;
+    pool->retired_head = NULL;
+    pool->retired_tail = NULL;
+    pool->node_blocks = NULL;
+    pool->free_nodes = NULL;
+    pool->retired_nodes_head = NULL;
+    pool->retired_nodes_tail = NULL;
+    pool->defer_reclaim = false;
+    pool->stats = (chunk_pool_stats){ 0 };
+}
+
+// Frees whole slabs and node blocks without visiting the chunks inside them
+void chunk_pool_destroy(chunk_pool *pool) {
+    chunk_slab *s = pool->slabs;
+    while (s) {
+        chunk_slab *next = s->next;
+        free(s);
+        s = next;
+    }
+    chunk_node_block *b = pool->node_blocks;
+    while (b) {
+        chunk_node_block *next = b->next;
+        free(b);
+        b = next;
+    }
+    chunk_pool_init(pool);
+}
+
+// Takes a chunk from the first slab with room: a recycled one if possible, otherwise a fresh slot
+chunk *chunk_pool_alloc(chunk_pool *pool) {
+    chunk_slab *s = pool->available;
+    if (!s) {
+        s = new_slab(pool);
+    }
+
+    chunk *c;
+    if (s->free_list) {
+        c = s->free_list;
+        s->free_list = c->next;
+    } else {
+        c = slab_chunk(s, s->carved++);
+    }
+
+    if (s->in_use++ == 0) {
+        pool->empty_slabs--;
+    }
+    if (s->in_use == CHUNKS_PER_SLAB) {
+        remove_available(pool, s);
+    }
+
+    pool->stats.allocations++;
+    pool->stats.live_chunks++;
+
+    c->length = 0;
+    c->newlines = 0;
+    c->hash = 0;
+    c->prev = c->next = NULL;
+    return c;
+}
+
+// Pushes the chunk onto its slab's free list; an emptied slab is released above the watermark
+void chunk_pool_free(chunk_pool *pool, chunk *c) {
+    chunk_slab *s = slab_of(c);
+    if (s->in_use == CHUNKS_PER_SLAB) {
+        push_available(pool, s);
+    }
+    c->next = s->free_list;
+    s->free_list = c;
+
+    pool->stats.frees++;
+    pool->stats.live_chunks--;
+
+    if (--s->in_use == 0) {
+        pool->empty_slabs++;
+        if (pool->empty_slabs > SLAB_HIGH_WATERMARK) {
+            release_slab(pool, s);
+        }
+    }
+}
+
+// TREE NODES
+
+// Takes a node from the free list, carving a new block into it when the list is empty.
+// Node blocks are kept until the pool is destroyed.
+chunk_node *chunk_pool_alloc_node(chunk_pool *pool) {
+    if (!pool->free_nodes) {
+        chunk_node_block *b = malloc(sizeof(chunk_node_block));
+        if (!b) {
+            out_of_memory("chunk_pool node block");
+        }
+        b->next = pool->node_blocks;
+        pool->node_blocks = b;
+        for (size_t i = 0; i < NODES_PER_BLOCK; i++) {
+            b->nodes[i].link = pool->free_nodes;
+            pool->free_nodes = &b->nodes[i];
+        }
+    }
+    chunk_node *n = pool->free_nodes;
+    pool->free_nodes = n->link;
+    pool->stats.live_nodes++;
+    return n;
+}
+
+// Pushes the node onto the free list
+void chunk_pool_free_node(chunk_pool *pool, chunk_node *n) {
+    n->link = pool->free_nodes;
+    pool->free_nodes = n;
+    pool->stats.live_nodes--;
+}
+
+// Queued through link rather than left/right, which readers of old snapshots still follow
+void chunk_pool_retire_node(chunk_pool *pool, chunk_node *n, uint64_t version) {
+    if (!pool->defer_reclaim) {
+        chunk_pool_free_node(pool, n);
+        return;
+    }
+    n->retired_version = version;
+    n->link = NULL;
+    if (pool->retired_nodes_tail) {
+        pool->retired_nodes_tail->link = n;
+    } else {
+        pool->retired_nodes_head = n;
+    }
+    pool->retired_nodes_tail = n;
+    pool->stats.retired_nodes++;
+}
+
+// RETIREMENT
+
+// Retired chunks are queued in retirement order, so their versions never decrease along the list
+void chunk_pool_retire(chunk_pool *pool, chunk *c, uint64_t version) {
+    if (!pool->defer_reclaim) {
+        chunk_pool_free(pool, c);
+        return;
+    }
+    c->retired_version = version;
+    c->next = NULL;
+    if (pool->retired_tail) {
+        pool->retired_tail->next = c;
+    } else {
+        pool->retired_head = c;
+    }
+    pool->retired_tail = c;
+    pool->stats.retired_chunks++;
+}
+
+// Frees from the front of the queue until it reaches a chunk an old snapshot may still see
+void chunk_pool_reclaim(chunk_pool *pool, uint64_t oldest_version) {
+    while (pool->retired_head && pool->retired_head->retired_version < oldest_version) {
+        chunk *c = pool->retired_head;
+        pool->retired_head = c->next;
+        chunk_pool_free(pool, c);
+        pool->stats.retired_chunks--;
+    }
+    if (!pool->retired_head) {
+        pool->retired_tail = NULL;
+    }
+
+    while (pool->retired_nodes_head && pool->retired_nodes_head->retired_version < oldest_version) {
+        chunk_node *n = pool->retired_nodes_head;
+        pool->retired_nodes_head = n->link;
+        chunk_pool_free_node(pool, n);
+        pool->stats.retired_nodes--;
+    }
+    if (!pool->retired_nodes_head) {
+        pool->retired_nodes_tail = NULL;
+    }
+}
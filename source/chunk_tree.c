@@ -0,0 +1,426 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../libs/chunk_tree.h"
+#include "../libs/chunk_pool.h"
+#include "../libs/scan.h"
+
+#define HASH_STRIDE 4 // Bytes folded into the hash per modular reduction
+
+// DOC_HASH_BASE^i for every possible chunk length
+static uint64_t hash_powers[CHUNK_SIZE + 1];
+
+// HELPER FUNCTIONS
+
+// Reduces a product below 2^123 modulo 2^61 - 1, using 2^61 = 1
+static uint64_t hash_reduce(__uint128_t x) {
+    uint64_t r = (uint64_t)(x & DOC_HASH_MOD) + (uint64_t)(x >> 61);
+    r = (r & DOC_HASH_MOD) + (r >> 61);
+    return (r >= DOC_HASH_MOD) ? r - DOC_HASH_MOD : r;
+}
+
+// Multiplies two hash values
+static uint64_t hash_mul(uint64_t a, uint64_t b) {
+    return hash_reduce((__uint128_t)a * b);
+}
+
+// Adds two hash values
+static uint64_t hash_add(uint64_t a, uint64_t b) {
+    uint64_t r = a + b;
+    return (r >= DOC_HASH_MOD) ? r - DOC_HASH_MOD : r;
+}
+
+// Fills the power table once, before main() runs
+__attribute__((constructor)) static void hash_powers_init(void) {
+    hash_powers[0] = 1;
+    for (size_t i = 1; i <= CHUNK_SIZE; i++) {
+        hash_powers[i] = hash_mul(hash_powers[i - 1], DOC_HASH_BASE);
+    }
+}
+
+// Returns the hash of a (possibly empty) subtree
+static uint64_t subtree_hash(const chunk_node *n) {
+    return n ? n->subtree_hash : 0;
+}
+
+// Returns DOC_HASH_BASE^length for a (possibly empty) subtree
+static uint64_t subtree_power(const chunk_node *n) {
+    return n ? n->subtree_power : 1;
+}
+
+// Returns the number of characters held by a (possibly empty) subtree
+static size_t subtree_length(const chunk_node *n) {
+    return n ? n->subtree_length : 0;
+}
+
+// Returns the number of newlines held by a (possibly empty) subtree
+static size_t subtree_newlines(const chunk_node *n) {
+    return n ? n->subtree_newlines : 0;
+}
+
+// Recomputes the cached totals of a single node from its chunk and children
+static void pull(chunk_node *n) {
+    const chunk *c = n->chunk;
+    n->subtree_length = c->length + subtree_length(n->left) + subtree_length(n->right);
+    n->subtree_newlines = c->newlines + subtree_newlines(n->left) + subtree_newlines(n->right);
+
+    // hash(left + self + right) = (hash(left) * B^|self| + hash(self)) * B^|right| + hash(right)
+    uint64_t self_power = hash_powers[c->length];
+    uint64_t through_self = hash_add(hash_mul(subtree_hash(n->left), self_power), c->hash);
+    n->subtree_hash = hash_add(hash_mul(through_self, subtree_power(n->right)), subtree_hash(n->right));
+    n->subtree_power = hash_mul(hash_mul(subtree_power(n->left), self_power), subtree_power(n->right));
+}
+
+// Generates the next heap priority for a new chunk (xorshift32)
+static uint32_t next_priority(document *doc) {
+    uint32_t x = doc->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    doc->seed = x;
+    return x;
+}
+
+// Makes a leaf node for a newly linked chunk
+static chunk_node *new_node(document *doc, chunk *c) {
+    chunk_node *n = chunk_pool_alloc_node(&doc->pool);
+    n->left = NULL;
+    n->right = NULL;
+    n->chunk = c;
+    n->priority = next_priority(doc);
+    n->epoch = doc->tree_epoch;
+    pull(n);
+    return n;
+}
+
+// Returns a node the writer may change: the node itself if no snapshot can see it yet,
+// otherwise a copy, retiring the original at the current version
+static chunk_node *writable(document *doc, chunk_node *n) {
+    if (n->epoch == doc->tree_epoch) {
+        return n;
+    }
+    chunk_node *copy = chunk_pool_alloc_node(&doc->pool);
+    *copy = *n;
+    copy->epoch = doc->tree_epoch;
+    chunk_pool_retire_node(&doc->pool, n, doc->version);
+    return copy;
+}
+
+// Gives up a node that has left the tree, straight away if no snapshot can see it
+static void drop_node(document *doc, chunk_node *n) {
+    if (n->epoch == doc->tree_epoch) {
+        chunk_pool_free_node(&doc->pool, n);
+    } else {
+        chunk_pool_retire_node(&doc->pool, n, doc->version);
+    }
+}
+
+// Splits a subtree into the chunks before pos and the rest (pos is on a chunk boundary).
+// Only the nodes on the path to pos are made writable; a split at either end of a subtree
+// leaves it untouched, so a side that receives nothing is shared as it was.
+static void split(document *doc, chunk_node *n, size_t pos, chunk_node **left, chunk_node **right) {
+    if (!n) {
+        *left = *right = NULL;
+        return;
+    }
+
+    size_t left_len = subtree_length(n->left);
+    chunk_node *l, *r;
+    if (pos <= left_len) {
+        split(doc, n->left, pos, &l, &r);
+        if (l) {
+            n = writable(doc, n);
+            n->left = r;
+            pull(n);
+        }
+        *left = l;
+        *right = n;
+    } else {
+        split(doc, n->right, pos - left_len - n->chunk->length, &l, &r);
+        if (r) {
+            n = writable(doc, n);
+            n->right = l;
+            pull(n);
+        }
+        *left = n;
+        *right = r;
+    }
+}
+
+// Joins two subtrees where every chunk of a comes before every chunk of b
+static chunk_node *merge(document *doc, chunk_node *a, chunk_node *b) {
+    if (!a) {
+        return b;
+    }
+    if (!b) {
+        return a;
+    }
+    if (a->priority > b->priority) {
+        a = writable(doc, a);
+        a->right = merge(doc, a->right, b);
+        pull(a);
+        return a;
+    }
+    b = writable(doc, b);
+    b->left = merge(doc, a, b->left);
+    pull(b);
+    return b;
+}
+
+// Builds a treap over a list of new chunks in O(k), keeping the rightmost path on a stack.
+// A node's totals are pulled when it leaves the stack, once both its children are final.
+static chunk_node *build(document *doc, chunk *first) {
+    chunk_node *inline_stack[64];
+    chunk_node **stack = inline_stack;
+    size_t capacity = sizeof(inline_stack) / sizeof(inline_stack[0]);
+    size_t depth = 0;
+
+    for (chunk *c = first; c; c = c->next) {
+        chunk_node *n = new_node(doc, c);
+        chunk_node *popped = NULL;
+        while (depth > 0 && stack[depth - 1]->priority < n->priority) {
+            popped = stack[--depth];
+            pull(popped);
+        }
+        n->left = popped;
+        if (depth > 0) {
+            stack[depth - 1]->right = n;
+        }
+
+        if (depth == capacity) {
+            capacity *= 2;
+            if (stack == inline_stack) {
+                stack = malloc(capacity * sizeof(chunk_node *));
+                memcpy(stack, inline_stack, sizeof(inline_stack));
+            } else {
+                stack = realloc(stack, capacity * sizeof(chunk_node *));
+            }
+        }
+        stack[depth++] = n;
+    }
+
+    chunk_node *root = NULL;
+    while (depth > 0) {
+        root = stack[--depth];
+        pull(root);
+    }
+    if (stack != inline_stack) {
+        free(stack);
+    }
+    return root;
+}
+
+// Retires every chunk and node of a subtree that was cut out of the tree
+static void retire_subtree(document *doc, chunk_node *n) {
+    if (!n) {
+        return;
+    }
+    retire_subtree(doc, n->left);
+    retire_subtree(doc, n->right);
+
+    chunk *c = n->chunk;
+    doc->chunk_count--;
+    if (c->length < UNDERFULL_CHUNK_LEN) {
+        doc->underfull_chunks--;
+    }
+    chunk_pool_retire(&doc->pool, c, doc->version);
+    drop_node(doc, n);
+}
+
+// Returns the first chunk (in document order) of a non-empty subtree
+static chunk *leftmost(const chunk_node *n) {
+    while (n->left) {
+        n = n->left;
+    }
+    return n->chunk;
+}
+
+// Returns the last chunk (in document order) of a non-empty subtree
+static chunk *rightmost(const chunk_node *n) {
+    while (n->right) {
+        n = n->right;
+    }
+    return n->chunk;
+}
+
+// LOOKUPS
+
+// Walks down from the root, skipping whole subtrees that end before the position
+chunk *chunk_tree_find(const document *doc, size_t pos, size_t *local_offset) {
+    const chunk_node *current = doc->root;
+
+    while (current) {
+        size_t left_len = subtree_length(current->left);
+        if (pos < left_len) {
+            current = current->left;
+        } else if (pos < left_len + current->chunk->length) {
+            *local_offset = pos - left_len;
+            return current->chunk;
+        } else {
+            pos -= left_len + current->chunk->length;
+            current = current->right;
+        }
+    }
+
+    return NULL;
+}
+
+// Counts newlines before pos, summing whole subtrees on the way down
+size_t chunk_tree_newlines_before(const document *doc, size_t pos) {
+    const chunk_node *current = doc->root;
+    size_t count = 0;
+
+    while (current) {
+        const chunk *c = current->chunk;
+        size_t left_len = subtree_length(current->left);
+        if (pos < left_len) {
+            current = current->left;
+        } else if (pos < left_len + c->length) {
+            return count + subtree_newlines(current->left) + count_newlines(c->data, pos - left_len);
+        } else {
+            pos -= left_len + c->length;
+            count += subtree_newlines(current->left) + c->newlines;
+            current = current->right;
+        }
+    }
+
+    return count;
+}
+
+// Descends by newline counts to the chunk holding the newline, then scans that chunk
+size_t chunk_tree_find_newline(const document *doc, size_t index) {
+    const chunk_node *current = doc->root;
+    size_t offset = 0;
+
+    while (current) {
+        const chunk *c = current->chunk;
+        size_t left_newlines = subtree_newlines(current->left);
+        if (index < left_newlines) {
+            current = current->left;
+        } else if (index < left_newlines + c->newlines) {
+            offset += subtree_length(current->left);
+            index -= left_newlines;
+            const char *p = c->data;
+            const char *end = c->data + c->length;
+            while ((p = scan->find_newline(p, (size_t)(end - p))) != NULL) {
+                if (index == 0) {
+                    return offset + (size_t)(p - c->data);
+                }
+                index--;
+                p++;
+            }
+            break;
+        } else {
+            index -= left_newlines + c->newlines;
+            offset += subtree_length(current->left) + c->length;
+            current = current->right;
+        }
+    }
+
+    return doc->length;
+}
+
+// Counts newlines with the fastest kernel the CPU supports
+size_t count_newlines(const char *data, size_t len) {
+    return scan->count_newlines(data, len);
+}
+
+// Horner's rule, folding HASH_STRIDE bytes into a single reduction
+void chunk_hash_append(chunk *c, const char *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = c->hash;
+    size_t i = 0;
+    for (; i + HASH_STRIDE <= len; i += HASH_STRIDE) {
+        __uint128_t acc = (__uint128_t)h * hash_powers[4] + (__uint128_t)p[i] * hash_powers[3] +
+                          (__uint128_t)p[i + 1] * hash_powers[2] + (__uint128_t)p[i + 2] * hash_powers[1] + p[i + 3];
+        h = hash_reduce(acc);
+    }
+    for (; i < len; i++) {
+        h = hash_reduce((__uint128_t)h * DOC_HASH_BASE + p[i]);
+    }
+    c->hash = h;
+}
+
+// The root's subtree covers the whole text
+uint64_t chunk_tree_hash(const document *doc) {
+    return doc->root ? doc->root->subtree_hash : 0;
+}
+
+// UPDATES
+
+// Cuts the old run out with two splits, builds the new run, and merges the three back together
+void chunk_tree_replace(document *doc, size_t start, size_t end, chunk *first) {
+    chunk_node *before, *rest, *old, *after;
+    split(doc, doc->root, start, &before, &rest);
+    split(doc, rest, end - start, &old, &after);
+
+    chunk *prev = before ? rightmost(before) : NULL;
+    chunk *next = after ? leftmost(after) : NULL;
+    retire_subtree(doc, old);
+
+    // Link the new chunks between the neighbours of the old run
+    chunk *last = prev;
+    for (chunk *c = first; c; c = c->next) {
+        c->prev = last;
+        last = c;
+        doc->chunk_count++;
+        if (c->length < UNDERFULL_CHUNK_LEN) {
+            doc->underfull_chunks++;
+        }
+    }
+    chunk_node *added = build(doc, first);
+    if (prev) {
+        prev->next = first ? first : next;
+    } else {
+        doc->head = first ? first : next;
+    }
+    if (last) {
+        last->next = next;
+    }
+    if (next) {
+        next->prev = last;
+    } else {
+        doc->tail = last;
+    }
+
+    doc->root = merge(doc, merge(doc, before, added), after);
+}
+
+// CHUNK ITERATOR
+
+// Pushes a node and its chain of left children, leftmost on top
+static void iter_descend(chunk_iter *it, const chunk_node *n) {
+    for (; n; n = n->left) {
+        if (it->depth == it->capacity) {
+            it->capacity = it->capacity ? it->capacity * 2 : 64;
+            it->stack = realloc(it->stack, it->capacity * sizeof(chunk_node *));
+        }
+        it->stack[it->depth++] = n;
+    }
+}
+
+// The stack holds the path of nodes still to be visited, so it stays O(tree height)
+void chunk_iter_init(chunk_iter *it, const chunk_node *root) {
+    it->stack = NULL;
+    it->depth = 0;
+    it->capacity = 0;
+    iter_descend(it, root);
+}
+
+// Visits the top node, then moves into its right subtree
+const chunk *chunk_iter_next(chunk_iter *it) {
+    if (it->depth == 0) {
+        return NULL;
+    }
+    const chunk_node *n = it->stack[--it->depth];
+    iter_descend(it, n->right);
+    return n->chunk;
+}
+
+// Only the stack is owned by the walk
+void chunk_iter_free(chunk_iter *it) {
+    free(it->stack);
+    it->stack = NULL;
+    it->depth = it->capacity = 0;
+}
@@ -11,29 +11,39 @@
 
 #include "../libs/client.h"
 #include "../libs/markdown.h"
+#include "../libs/commit.h"
+#include "../libs/chunk_tree.h"
 #include "../libs/helper.h"
+#include "../libs/scan.h"
+#include "../libs/resync.h"
+#include "../libs/ops.h"
+#include "../libs/frame.h"
 
 #define MAX_RESPONSE_LEN 512 // Max size of a broadcast line
 #define VERSION_BUF_SIZE 32 // Buffer size for document version string
 #define VERSION_PREFIX_LEN 8 // Length of "VERSION " prefix in broadcasts
 #define LENGTH_BUF_SIZE 32 // Buffer size for document length string
-#define ASCII_PRINT_MIN 32
-#define ASCII_PRINT_MAX 126
 #define BASE_DECIMAL 10
+#define BASE_HEX 16
+#define CACHE_PATH_LEN 160 // Buffer size for the cache file name
+#define CACHE_PATH_FMT ".%s.doc.cache" // Per-user copy of the document kept between sessions
+#define PASTE_END_LINE "PASTE_END" // Ends the lines of a PASTE
 
 // Local copy of document and log of all broadcasts
 document *doc = NULL;
 log_line *log_head = NULL;
 log_line *log_tail = NULL;
+bool diverged = false; // Set when a broadcast's hash disagrees with the local copy, until RESYNC
+bool binary = false; // Messages after the handshake are frames (--binary, confirmed by the server)
+uint32_t user_id = 0; // Id the server assigned to this connection, stamped on every frame sent
 
 /*
- * Appends a line from the server broadcast (VERSION, EDIT, or END)
- * to the client's local broadcast log. This will be used to implement
- * the LOG? command and maintain a record of all changes received.
+ * Appends a log entry that takes ownership of either a line of text or a primitive
  */
-void append_log_line(const char *line) {
+void append_log_node(char *line, edit *op) {
     log_line *new_node = malloc(sizeof(log_line));
-    new_node->line = strdup(line);
+    new_node->line = line;
+    new_node->op = op;
     new_node->next = NULL;
 
     if (!log_head) {
@@ -44,6 +54,57 @@ void append_log_line(const char *line) {
     }
 }
 
+/*
+ * Appends a line from the server broadcast (VERSION, EDIT, or END)
+ * to the client's local broadcast log. This will be used to implement
+ * the LOG? command and maintain a record of all changes received.
+ */
+void append_log_line(const char *line) {
+    append_log_node(strdup(line), NULL);
+}
+
+/*
+ * Appends the text of a FRAME_EDIT to the log, with the newline a text line ends in
+ */
+void append_log_text(const char *text, size_t len) {
+    char *line = malloc(len + 2);
+    memcpy(line, text, len);
+    line[len] = '\n';
+    line[len + 1] = '\0';
+    append_log_node(line, NULL);
+}
+
+/*
+ * Appends a primitive received as a binary frame to the log. It is kept as an edit and
+ * only formatted as its "OP ..." line if LOG? asks for it.
+ */
+void append_log_op(edit_type type, const frame_span *span, const char *text) {
+    edit *op = calloc(1, sizeof(edit));
+    op->type = type;
+    op->pos = span->pos;
+    if (type == EDIT_INSERT) {
+        op->text = strdup(text);
+    } else {
+        op->del_len = span->len;
+    }
+    append_log_node(NULL, op);
+}
+
+/*
+ * Prints the log as the server sent it, formatting primitives received as frames
+ */
+void print_log() {
+    for (log_line *curr = log_head; curr != NULL; curr = curr->next) {
+        if (curr->op) {
+            char *line = ops_format(curr->op, false);
+            printf("%s\n", line);
+            free(line);
+        } else {
+            printf("%s", curr->line);
+        }
+    }
+}
+
 /*
  * Frees all memory used by the client's local broadcast log.
  * Called on client shutdown to prevent memory leaks.
@@ -53,6 +114,10 @@ void free_log() {
     while (curr) {
         log_line *next = curr->next;
         free(curr->line);
+        if (curr->op) {
+            free(curr->op->text);
+            free(curr->op);
+        }
         free(curr);
         curr = next;
     }
@@ -60,13 +125,154 @@ void free_log() {
 }
 
 /*
- * Checks the server-to-client FIFO for any pending broadcasts.
- * - Parses and logs each VERSION, EDIT result and END marker.
- * - Only applies successful EDIT commands to the local document.
- * - Commits changes by incrementing the local document version.
+ * Moves the local copy to the version of a block it has just applied, and checks the result
+ * against the hash the server sent for the same version, if there was one
+ */
+void finish_block(uint64_t new_version, bool has_hash, uint64_t hash) {
+    // Update document version (every success was already committed at its "OP C")
+    doc->version = new_version;
+
+    if (has_hash && !diverged && hash != chunk_tree_hash(doc)) {
+        diverged = true;
+        fprintf(stderr, "Warning: local document diverged from the server at version %llu (RESYNC repairs it)\n",
+                (unsigned long long)new_version);
+    }
+}
+
+/*
+ * Reads the rest of one broadcast block whose VERSION line has already been read.
+ * - Logs each EDIT result, primitive and the END marker.
+ * - Applies the resolved primitives ("OP ...") that follow each successful EDIT, committing
+ *   at each "OP C" exactly as the server did, without re-running the formatting logic.
+ * - Checks the result against the hash the server sent for the same version.
+ * - With apply unset (a block the local copy already includes) the block is only logged.
+ */
+void apply_block(FILE *s2c, const char *version_line, bool apply) {
+    uint64_t new_version = strtoull(version_line + VERSION_PREFIX_LEN, NULL, BASE_DECIMAL);
+    char *edit_line = NULL; // Primitive lines carry whole inserts, so they are read without a length limit
+    size_t edit_cap = 0;
+    ssize_t n;
+
+    // The server writes a block line by line, so wait for the rest of it even when polling
+    // (a block replayed from memory has no descriptor)
+    int fd_raw = fileno(s2c);
+    int old_flags = (fd_raw >= 0) ? fcntl(fd_raw, F_GETFL) : 0;
+    if (fd_raw >= 0) {
+        fcntl(fd_raw, F_SETFL, old_flags & ~O_NONBLOCK);
+    }
+    clearerr(s2c); // An earlier poll that found nothing leaves the error flag set
+
+    // Store VERSION line in log
+    append_log_line(version_line);
+
+    // Process all command results for this version
+    while ((n = getline(&edit_line, &edit_cap, s2c)) > 0) {
+        // Log all edits and END
+        append_log_line(edit_line); 
+
+        if (strncmp(edit_line, "END", 3) == 0) { // 3 = strlen("END")
+            break;
+        }
+
+        if (apply && strncmp(edit_line, OPS_PREFIX, OPS_PREFIX_LEN) == 0) {
+            if (edit_line[n - 1] == '\n') {
+                edit_line[n - 1] = '\0';
+            }
+            ops_apply_line(doc, edit_line);
+        }
+    }
+    free(edit_line);
+    if (fd_raw >= 0) {
+        fcntl(fd_raw, F_SETFL, old_flags);
+    }
+
+    // Compare against the server's hash of the same version ("VERSION <v> <hash>")
+    if (apply) {
+        const char *hash_str = strchr(version_line + VERSION_PREFIX_LEN, ' ');
+        finish_block(new_version, hash_str != NULL, hash_str ? strtoull(hash_str + 1, NULL, BASE_HEX) : 0);
+    }
+}
+
+/*
+ * Reads the rest of one binary broadcast block whose FRAME_VERSION has already been read.
+ * - Primitives are applied straight from the frame (no parsing or unescaping) and the
+ *   commit frames commit them, exactly as for the text "OP" lines.
+ * - The block is logged as the same lines a text client logs, with primitives formatted
+ *   only if LOG? prints them.
+ * - With apply unset (a block the local copy already includes) the block is only logged.
+ * Returns false if the stream ended or was malformed.
+ */
+bool apply_frame_block(FILE *s2c, const frame_header *start, const char *hash, bool apply) {
+    uint64_t doc_hash = 0;
+    memcpy(&doc_hash, hash, start->length < sizeof(doc_hash) ? start->length : sizeof(doc_hash));
+    char version_line[MAX_RESPONSE_LEN];
+    snprintf(version_line, sizeof(version_line), "VERSION %llu %016llx\n",
+             (unsigned long long)start->version, (unsigned long long)doc_hash);
+    append_log_line(version_line);
+
+    frame_header h;
+    char *payload = NULL;
+    size_t capacity = 0;
+    bool ok = false;
+    while (frame_read(s2c, &h, &payload, &capacity, UINT32_MAX)) {
+        frame_span span = { 0, 0 };
+        if ((h.opcode == FRAME_INSERT || h.opcode == FRAME_DELETE) && h.length >= sizeof(span)) {
+            memcpy(&span, payload, sizeof(span));
+        }
+        if (h.opcode == FRAME_END) {
+            append_log_line("END\n");
+            ok = true;
+            break;
+        } else if (h.opcode == FRAME_EDIT) {
+            append_log_text(payload, h.length);
+        } else if (h.opcode == FRAME_INSERT && h.length >= sizeof(span)) {
+            const char *text = payload + sizeof(span);
+            if (apply) {
+                markdown_insert(doc, doc->version, span.pos, text);
+            }
+            append_log_op(EDIT_INSERT, &span, text);
+        } else if (h.opcode == FRAME_DELETE && h.length >= sizeof(span)) {
+            if (apply) {
+                markdown_delete(doc, doc->version, span.pos, span.len);
+            }
+            append_log_op(EDIT_DELETE, &span, NULL);
+        } else if (h.opcode == FRAME_COMMIT) {
+            if (apply) {
+                markdown_increment_version(doc);
+            }
+            append_log_line(OPS_COMMIT_LINE "\n");
+        }
+    }
+    free(payload);
+    if (apply) {
+        finish_block(start->version, start->length >= sizeof(doc_hash), doc_hash);
+    }
+    return ok;
+}
+
+/*
+ * Checks the server-to-client FIFO for any pending broadcasts and applies each block.
+ * Other lines are still kept for LOG?.
  * This function is made to be non-blocking to prevent blocking the user input loop.
  */
 void apply_broadcasts(FILE *s2c) {
+    if (binary) {
+        // A block is written with one writev, so once its first byte is here the rest follows
+        frame_header h;
+        char *payload = NULL;
+        size_t capacity = 0;
+        while (frame_poll(s2c) && frame_read(s2c, &h, &payload, &capacity, UINT32_MAX)) {
+            if (h.opcode == FRAME_VERSION) {
+                apply_frame_block(s2c, &h, payload, true);
+            } else if (h.opcode == FRAME_EDIT) {
+                // Not part of a block, but still kept for LOG? (a rejected invalid command)
+                append_log_text(payload, h.length);
+            }
+        }
+        free(payload);
+        return;
+    }
+
     // Temporarily enable non-blocking mode to check for available broadcasts without hanging
     char resp[MAX_RESPONSE_LEN];
     int fd_raw = fileno(s2c);
@@ -75,45 +281,7 @@ void apply_broadcasts(FILE *s2c) {
 
     while (fgets(resp, sizeof(resp), s2c)) {
         if (strncmp(resp, "VERSION", 7) == 0) { // 7 = strlen("VERSION")
-            uint64_t new_version = strtoull(resp + VERSION_PREFIX_LEN, NULL, BASE_DECIMAL);
-            char edit_line[MAX_RESPONSE_LEN];
-
-            // Store VERSION line in log
-            append_log_line(resp);
-
-            // Process all command results for this version
-            while (fgets(edit_line, sizeof(edit_line), s2c)) {
-                // Log all edits and END
-                append_log_line(edit_line); 
-
-                if (strncmp(edit_line, "END", 3) == 0) { // 3 = strlen("END")
-                    break;
-                }
-
-                if (strstr(edit_line, "SUCCESS")) {
-                    // Extract the command string by skipping two spaces
-                    char *cmd_start = strchr(edit_line, ' ');
-                    if (!cmd_start) {
-                        continue;
-                    }
-                    cmd_start = strchr(cmd_start + 1, ' ');
-                    if (!cmd_start) {
-                        continue;
-                    }
-                    cmd_start++;
-
-                    char *end = strstr(cmd_start, " SUCCESS");
-                    if (end) {
-                        *end = '\0';
-                    }
-
-                    // Apply the command to the local document
-                    process_command(doc, cmd_start, doc->version);
-                }
-            }
-            // Commit changes and update document version
-            markdown_increment_version(doc);
-            doc->version = new_version;
+            apply_block(s2c, resp, true);
         } else {
             // Not a VERSION block, but still kept for LOG?
             append_log_line(resp);
@@ -123,6 +291,252 @@ void apply_broadcasts(FILE *s2c) {
     fcntl(fd_raw, F_SETFL, old_flags);
 }
 
+/*
+ * Loads the copy of the document cached by this user's previous session.
+ * The file holds the version, the length and the text, as sent in the handshake.
+ * Returns the text (caller frees) or NULL if there is no usable cache.
+ */
+char *load_cache(const char *username, uint64_t *version, size_t *length) {
+    char path[CACHE_PATH_LEN];
+    snprintf(path, sizeof(path), CACHE_PATH_FMT, username);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return NULL;
+    }
+    unsigned long long v;
+    size_t len;
+    char *text = NULL;
+    if (fscanf(file, "%llu\n%zu", &v, &len) == 2 && fgetc(file) == '\n') {
+        text = malloc(len + 1);
+        if (fread(text, 1, len, file) == len) {
+            text[len] = '\0';
+            *version = v;
+            *length = len;
+        } else {
+            free(text);
+            text = NULL;
+        }
+    }
+    fclose(file);
+    return text;
+}
+
+/*
+ * Saves the local document so the next session only needs the edits made since.
+ * Written to a temporary file and renamed, so a crash never leaves a torn cache.
+ */
+void save_cache(const char *username) {
+    char path[CACHE_PATH_LEN];
+    char tmp_path[CACHE_PATH_LEN + 4]; // 4 = strlen(".tmp")
+    snprintf(path, sizeof(path), CACHE_PATH_FMT, username);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        return;
+    }
+    fprintf(file, "%llu\n%zu\n", (unsigned long long)doc->version, doc->length);
+    markdown_print(doc, file);
+    if (fclose(file) == 0) {
+        rename(tmp_path, path);
+    } else {
+        unlink(tmp_path);
+    }
+}
+
+/*
+ * Reads up to and including the first line of the server's answer to a RESYNC request.
+ * Everything broadcast ahead of the answer is copied to hold unread, to be replayed once
+ * the local copy is settled. Returns the line (caller frees) or NULL if the stream ended.
+ */
+char *read_resync_answer(FILE *s2c, FILE *hold) {
+    if (binary) {
+        frame_header h;
+        char *payload = NULL;
+        size_t capacity = 0;
+        bool reply = false;
+        while (!reply && frame_read(s2c, &h, &payload, &capacity, UINT32_MAX)) {
+            reply = (h.opcode == FRAME_RESYNC);
+            if (!reply) {
+                fwrite(&h, sizeof(h), 1, hold);
+                fwrite(payload, 1, h.length, hold);
+            }
+        }
+        free(payload);
+        if (!reply) {
+            return NULL;
+        }
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    clearerr(s2c); // An earlier poll that found nothing leaves the error flag set
+    while (getline(&line, &capacity, s2c) > 0) {
+        if (strncmp(line, "RESYNC", 6) == 0) { // 6 = strlen("RESYNC"), also the start of RESYNC_REJECTED
+            return line;
+        }
+        fputs(line, hold);
+    }
+    free(line);
+    return NULL;
+}
+
+/*
+ * Replays the broadcasts held back while waiting for a RESYNC answer. Blocks the local copy
+ * already includes are only logged; later ones are applied as if they had just arrived.
+ */
+void replay_held(char *held, size_t held_len) {
+    FILE *in = held_len ? fmemopen(held, held_len, "r") : NULL;
+    if (!in) {
+        return;
+    }
+    if (binary) {
+        frame_header h;
+        char *payload = NULL;
+        size_t capacity = 0;
+        while (frame_read(in, &h, &payload, &capacity, UINT32_MAX)) {
+            if (h.opcode == FRAME_VERSION) {
+                apply_frame_block(in, &h, payload, h.version > doc->version);
+            }
+        }
+        free(payload);
+    } else {
+        char *line = NULL;
+        size_t capacity = 0;
+        while (getline(&line, &capacity, in) > 0) {
+            if (strncmp(line, "VERSION", 7) == 0) { // 7 = strlen("VERSION")
+                uint64_t version = strtoull(line + VERSION_PREFIX_LEN, NULL, BASE_DECIMAL);
+                apply_block(in, line, version > doc->version);
+            } else {
+                append_log_line(line);
+            }
+        }
+        free(line);
+    }
+    fclose(in);
+}
+
+/*
+ * Brings the local document back in line with the server without a full transfer.
+ * - Sends block signatures of the local copy.
+ * - Holds back broadcasts queued ahead of the reply, then replays them: those the reply
+ *   already includes are only logged, later ones are applied to the rebuilt copy.
+ * - Rebuilds the document from the reply's copied blocks and literal bytes.
+ * - If the server rejects the request the local copy is kept and the held broadcasts are
+ *   applied to it, so none of their edits are lost. A malformed reply also keeps the copy but
+ *   marks it diverged, since the reply may not have been read exactly.
+ * Returns 0 on success, -1 if the server rejected the request or the reply was malformed.
+ */
+int resync_document(int fd_c2s, FILE *s2c) {
+    char *held = NULL;
+    size_t held_len = 0;
+    FILE *hold = open_memstream(&held, &held_len);
+    FILE *c2s = hold ? fdopen(dup(fd_c2s), "w") : NULL;
+    if (!c2s) {
+        if (hold) {
+            fclose(hold);
+            free(held);
+        }
+        return -1;
+    }
+    char *basis = markdown_flatten(doc);
+    size_t basis_len = doc->length;
+    if (binary) {
+        frame_write(fd_c2s, FRAME_RESYNC, user_id, doc->version, NULL, 0); // The request follows as text
+    }
+    resync_send_signature(c2s, basis, basis_len, RESYNC_BLOCK_SIZE);
+    fclose(c2s);
+
+    char *answer = read_resync_answer(s2c, hold);
+    unsigned long long version = 0;
+    size_t length = 0;
+    resync_stats stats;
+    char *text = NULL;
+    bool resynced = false;
+    if (answer && sscanf(answer, "RESYNC %llu %zu", &version, &length) == 2) {
+        text = resync_apply(s2c, basis, basis_len, RESYNC_BLOCK_SIZE, length, &stats);
+        if (!text) {
+            diverged = true;
+            fprintf(stderr, "Warning: malformed RESYNC reply, the local document may differ from the server\n");
+        }
+    }
+    free(answer);
+    free(basis);
+
+    if (text) {
+        markdown_free(doc);
+        doc = markdown_init();
+        commit_load(doc, text, length);
+        doc->version = version;
+        free(text);
+        diverged = false;
+        resynced = true;
+        printf("RESYNC version %llu reused %zu received %zu\n", version, stats.copied, stats.literal);
+    }
+    fclose(hold);
+    replay_held(held, held_len);
+    free(held);
+    return resynced ? 0 : -1;
+}
+
+/*
+ * Reads the lines typed after "PASTE <pos>", up to a line holding only PASTE_END, and sends
+ * them, each with its newline, as one insert at pos. The text is streamed in frames:
+ * FRAME_PASTE_BEGIN with the position and length, FRAME_PASTE_DATA parts, FRAME_PASTE_END.
+ * The server stages it and applies it as a single edit, so a large paste is one version and
+ * one broadcast instead of hundreds of 255-byte INSERTs.
+ * Returns 0 on success, -1 if the paste was not sent (its lines are consumed either way).
+ */
+int send_paste(int fd_c2s, const char *args) {
+    char *end;
+    unsigned long long pos = strtoull(args, &end, BASE_DECIMAL);
+    bool valid = (end != args && *end == '\0');
+
+    char *text = NULL;
+    size_t text_len = 0;
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t n;
+    while ((n = getline(&line, &line_capacity, stdin)) > 0) {
+        size_t len = (line[n - 1] == '\n') ? (size_t)n - 1 : (size_t)n;
+        if (len == strlen(PASTE_END_LINE) && strncmp(line, PASTE_END_LINE, len) == 0) {
+            break;
+        }
+        if (scan->find_non_printable(line, len) != len || text_len + len + 1 > FRAME_MAX_PASTE_SIZE) {
+            valid = false; // Keep reading so none of the remaining lines run as commands
+        }
+        if (valid) {
+            text = realloc(text, text_len + len + 1);
+            memcpy(text + text_len, line, len);
+            text[text_len + len] = '\n';
+            text_len += len + 1;
+        }
+    }
+    free(line);
+
+    int result = -1;
+    if (!binary) {
+        fprintf(stderr, "Error: PASTE needs a binary connection (--binary)\n");
+    } else if (!valid || text_len == 0) {
+        fprintf(stderr, "Error: paste is empty, too long (max %d bytes) or not printable ASCII\n",
+                FRAME_MAX_PASTE_SIZE);
+    } else {
+        frame_span span = { pos, text_len };
+        result = frame_write(fd_c2s, FRAME_PASTE_BEGIN, user_id, doc->version, &span, sizeof(span));
+        for (size_t sent = 0; result == 0 && sent < text_len; sent += FRAME_PASTE_CHUNK_SIZE) {
+            size_t part = (text_len - sent < FRAME_PASTE_CHUNK_SIZE) ? text_len - sent : FRAME_PASTE_CHUNK_SIZE;
+            result = frame_write(fd_c2s, FRAME_PASTE_DATA, user_id, doc->version, text + sent, part);
+        }
+        if (result == 0) {
+            result = frame_write(fd_c2s, FRAME_PASTE_END, user_id, doc->version, NULL, 0);
+        }
+        if (result != 0) {
+            perror("Failed to send paste");
+        }
+    }
+    free(text);
+    return result;
+}
+
 /*
  * Entry point of client program.
  * - Performs a signal-based handshake with the server.
@@ -131,8 +545,9 @@ void apply_broadcasts(FILE *s2c) {
  * - Enters a loop to process user commands and apply server broadcasts to sync local document.
 */
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: ./client <server_pid> <username>\n");
+    bool want_binary = (argc == 4 && strcmp(argv[3], "--binary") == 0);
+    if (argc != 3 && !want_binary) {
+        fprintf(stderr, "Usage: ./client <server_pid> <username> [--binary]\n");
         return 1;
     }
 
@@ -163,8 +578,17 @@ int main(int argc, char *argv[]) {
     int fd_c2s = open(fifo_c2s, O_WRONLY);
     int fd_s2c = open(fifo_s2c, O_RDONLY);
 
-    // Send username to server
-    dprintf(fd_c2s, "%s\n", username);
+    // Send username to server, with the version of our cached copy if there is one, and ask
+    // for binary framing if wanted
+    uint64_t cached_version = 0;
+    size_t cached_length = 0;
+    char *cached = load_cache(username, &cached_version, &cached_length);
+    const char *binary_request = want_binary ? " " FRAME_BINARY_TOKEN : "";
+    if (cached) {
+        dprintf(fd_c2s, "%s SINCE %llu%s\n", username, (unsigned long long)cached_version, binary_request);
+    } else {
+        dprintf(fd_c2s, "%s%s\n", username, binary_request);
+    }
 
     // Wrap server-to-client FIFO in FILE* for reading
     FILE *s2c = fdopen(fd_s2c, "r");
@@ -172,6 +596,7 @@ int main(int argc, char *argv[]) {
         perror("fdopen");
         close(fd_c2s);
         close(fd_s2c);
+        free(cached);
         return 1;
     }
 
@@ -181,6 +606,7 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Failed to read role from server.\n");
         close(fd_c2s);
         fclose(s2c);
+        free(cached);
         return 1;
     }
 
@@ -189,89 +615,115 @@ int main(int argc, char *argv[]) {
         printf("%s", role_line);
         close(fd_c2s);
         fclose(s2c);
+        free(cached);
         return 1;
     }
 
-    // Correctly format role line
+    // Correctly format role line, after checking whether the server agreed to binary framing
+    char *binary_token = strstr(role_line, " " FRAME_BINARY_TOKEN);
+    if (binary_token) {
+        binary = true;
+        user_id = (uint32_t)strtoul(binary_token + strlen(" " FRAME_BINARY_TOKEN), NULL, 10);
+        *binary_token = '\0';
+    }
     role_line[strcspn(role_line, "\n")] = '\0';
     char client_role[ROLE_LEN];
     strncpy(client_role, role_line, sizeof(client_role));
     client_role[sizeof(client_role) - 1] = '\0';
 
-    // 2. Read document version from server
+    // 2. Read document version from server, or the start of a catch-up from our cached copy
     char version_buf[VERSION_BUF_SIZE];
     if (!fgets(version_buf, sizeof(version_buf), s2c)) {
         fprintf(stderr, "Failed to read version.\n");
         close(fd_c2s);
         fclose(s2c);
+        free(cached);
         return 1;
     }
-    size_t doc_version = strtoull(version_buf, NULL, BASE_DECIMAL);
+    doc = markdown_init();
+    if (cached && strncmp(version_buf, "CATCHUP", 7) == 0) { // 7 = strlen("CATCHUP")
+        // Restore the cached copy and apply the broadcast blocks missed since
+        commit_load(doc, cached, cached_length);
+        doc->version = cached_version;
+        char resp[MAX_RESPONSE_LEN];
+        while (fgets(resp, sizeof(resp), s2c) && strncmp(resp, "CATCHUP_END", 11) != 0) { // 11 = strlen("CATCHUP_END")
+            if (strncmp(resp, "VERSION", 7) == 0) { // 7 = strlen("VERSION")
+                apply_block(s2c, resp, true);
+            }
+        }
+    } else {
+        size_t doc_version = strtoull(version_buf, NULL, BASE_DECIMAL);
+
+        // 3. Read document length from server
+        char length_buf[LENGTH_BUF_SIZE];
+        if (!fgets(length_buf, sizeof(length_buf), s2c)) {
+            fprintf(stderr, "Failed to read document length.\n");
+            markdown_free(doc);
+            close(fd_c2s);
+            fclose(s2c);
+            free(cached);
+            return 1;
+        }
+        size_t doc_length = strtoull(length_buf, NULL, BASE_DECIMAL);
 
-    // 3. Read document length from server
-    char length_buf[LENGTH_BUF_SIZE];
-    if (!fgets(length_buf, sizeof(length_buf), s2c)) {
-        fprintf(stderr, "Failed to read document length.\n");
-        close(fd_c2s);
-        fclose(s2c);
-        return 1;
-    }
-    size_t doc_length = strtoull(length_buf, NULL, BASE_DECIMAL);
+        // 4. Read document content from server
+        char *document = malloc(doc_length + 1);
+        size_t total_read = fread(document, 1, doc_length, s2c);
+        if (total_read < doc_length) {
+            fprintf(stderr, "Partial document read.\n");
+        }
+        document[total_read] = '\0';
 
-    // 4. Read document content from server
-    char *document = malloc(doc_length + 1);
-    size_t total_read = fread(document, 1, doc_length, s2c);
-    if (total_read < doc_length) {
-        fprintf(stderr, "Partial document read.\n");
+        // Initialise local document, packed straight into full chunks
+        commit_load(doc, document, total_read);
+        doc->version = doc_version;
+        free(document);
     }
-    document[doc_length] = '\0';
-
-    // Initialise local document
-    doc = markdown_init();
-    markdown_insert(doc, 0, 0, document);
-    doc->version = doc_version;
-    free(document);
+    free(cached);
 
     // Client command Loop
-    char input[MAX_INPUT_SIZE];
+    char *input = NULL; // Whole lines are read, so a long one is rejected rather than split
+    size_t input_capacity = 0;
     while (1) {
         fflush(stdout);
 
         // Read a line of user input
-        if (!fgets(input, sizeof(input), stdin)) {
+        ssize_t read_len = getline(&input, &input_capacity, stdin);
+        if (read_len < 0) {
             // EOF or error
             break;
         }
 
         // Strip trailing newline
-        size_t len = strlen(input);
+        size_t len = (size_t)read_len;
         if (len > 0 && input[len - 1] == '\n') {
             input[len - 1] = '\0';
             --len;
         }
 
-        // Enforce max command size (255 chars + '\n')
-        if (len + 1 > MAX_COMMAND_SIZE) {
+        // Enforce max command size (255 chars + '\n' as text, a frame's payload limit as binary)
+        if (!binary && len + 1 > MAX_COMMAND_SIZE) {
             fprintf(stderr, "Error: command too long (max 255 chars)\n");
             continue;
         }
+        if (binary && len > FRAME_MAX_COMMAND_SIZE) {
+            fprintf(stderr, "Error: command too long (max %d bytes)\n", FRAME_MAX_COMMAND_SIZE);
+            continue;
+        }
 
         // Enforce printable ASCII characters (32–126)
-        bool bad_input = false;
-        for (size_t i = 0; i < len; i++) {
-            if ((unsigned char)input[i] < ASCII_PRINT_MIN || (unsigned char)input[i] > ASCII_PRINT_MAX) {
-                bad_input = true;
-                break;
-            }
-        }
-        if (bad_input) {
+        if (scan->find_non_printable(input, len) != len) {
             fprintf(stderr, "Error: non-ASCII or non-printable character in command\n");
             continue;
         }
 
         // Send DISCONNECT to server, then break
         if (strcmp(input, "DISCONNECT") == 0) {
-            dprintf(fd_c2s, "%s\n", input);
+            if (binary) {
+                frame_write(fd_c2s, FRAME_DISCONNECT, user_id, doc->version, NULL, 0);
+            } else {
+                dprintf(fd_c2s, "%s\n", input);
+            }
             break;
         // Handle PERM?, LOG? and DOC? commands locally
         } else if (strcmp(input, "PERM?") == 0) {
@@ -279,27 +731,42 @@ int main(int argc, char *argv[]) {
 
         } else if (strcmp(input, "LOG?") == 0) {
             apply_broadcasts(s2c);
-            for (log_line *curr = log_head; curr != NULL; curr = curr->next) {
-                printf("%s", curr->line);
-            }
+            print_log();
         } else if (strcmp(input, "DOC?") == 0) {
             apply_broadcasts(s2c);
-            char *flat = markdown_flatten(doc);
-            printf("%s\n", flat);
-            free(flat);
+            markdown_print(doc, stdout);
+            printf("\n");
+        } else if (strcmp(input, "RESYNC") == 0) {
+            // Repair a local copy that may have drifted from the server's
+            apply_broadcasts(s2c);
+            if (resync_document(fd_c2s, s2c) != 0) {
+                fprintf(stderr, "Error: resync failed\n");
+            }
+        } else if (strncmp(input, "PASTE ", 6) == 0) { // 6 = strlen("PASTE ")
+            // Stream the lines that follow, up to PASTE_END, as a single insert (errors are reported there)
+            send_paste(fd_c2s, input + 6);
+            apply_broadcasts(s2c);
+        } else if (strcmp(input, "OUTLINE?") == 0) {
+            // List the headings, list items, blockquotes and rules of the local copy
+            apply_broadcasts(s2c);
+            markdown_outline(doc, stdout);
         // Otherwise, a normal editing command has been inputted and will be sent to the server
         } else {
-            if (dprintf(fd_c2s, "%s\n", input) < 0) {
+            int sent = binary ? frame_write(fd_c2s, FRAME_COMMAND, user_id, doc->version, input, len)
+                              : dprintf(fd_c2s, "%s\n", input);
+            if (sent < 0) {
                 perror("Failed to send command");
             }
             apply_broadcasts(s2c);
         }
     }
-    // Clean up resources
+    // Keep the local copy so the next session can catch up from it, then clean up resources
+    save_cache(username);
     markdown_free(doc);
     close(fd_c2s);
     fclose(s2c);
     close(fd_s2c);
     free_log();
+    free(input);
     return 0;
 }
\ No newline at end of file
@@ -3,29 +3,86 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define INITIAL_HEAP_CAPACITY 16 // First allocation for the drain heap
+
+// Links a node after the current tail: the exchange publishes it to later pushes, the store to the consumer
+static void push_node(command_queue *q, queued_command *node) {
+    atomic_store_explicit(&node->queue_next, NULL, memory_order_relaxed);
+    queued_command *prev = atomic_exchange_explicit(&q->tail, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->queue_next, node, memory_order_release);
+}
+
+// Takes the oldest node, or returns NULL if the queue is empty or its oldest push has not linked in yet
+static queued_command *pop_node(command_queue *q) {
+    queued_command *head = q->head;
+    queued_command *next = atomic_load_explicit(&head->queue_next, memory_order_acquire);
+    if (head == &q->stub) {
+        if (!next) {
+            return NULL;
+        }
+        q->head = next; // Skip over the stub
+        head = next;
+        next = atomic_load_explicit(&head->queue_next, memory_order_acquire);
+    }
+    if (next) {
+        q->head = next;
+        return head;
+    }
+    if (head != atomic_load_explicit(&q->tail, memory_order_acquire)) {
+        return NULL; // Another push has swapped the tail but not yet linked itself after head
+    }
+    // head is the last node: put the stub behind it so it can be handed out
+    push_node(q, &q->stub);
+    next = atomic_load_explicit(&head->queue_next, memory_order_acquire);
+    if (next) {
+        q->head = next;
+        return head;
+    }
+    return NULL;
+}
+
+// Starts with only the stub linked in
+void command_queue_init(command_queue *q) {
+    atomic_store_explicit(&q->stub.queue_next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, &q->stub, memory_order_relaxed);
+    q->head = &q->stub;
+}
 
 // Add a new command to the end of the queue
-void enqueue_command(queued_command **head, const char *user, const char *role, const char *cmd, uint64_t version) {
+void enqueue_command(command_queue *q, const char *user, uint32_t user_id, const char *role, const char *cmd,
+                     const parsed_command *op, uint64_t version) {
     queued_command *new_node = malloc(sizeof(queued_command));
     new_node->username = strdup(user);
+    new_node->user_id = user_id;
     new_node->role = strdup(role);
     new_node->command_str = strdup(cmd);
+    new_node->op = *op; // Offsets into the text, so they hold for the copy too
     new_node->client_version = version;
     // Capture the timestamp at the moment the command was received
     clock_gettime(CLOCK_MONOTONIC, &new_node->timestamp);
     new_node->next = NULL;
 
     // Append to the end of the queue
-    if (*head == NULL) {
-        *head = new_node;
-    } else {
-        queued_command *curr = *head;
-        while (curr->next) curr = curr->next;
-        curr->next = new_node;
+    push_node(q, new_node);
+}
+
+// Pops until the queue is empty, relinking the nodes through next in the same order
+queued_command *command_queue_drain(command_queue *q) {
+    queued_command *batch = NULL;
+    queued_command **tail = &batch;
+    queued_command *node;
+    while ((node = pop_node(q)) != NULL) {
+        node->next = NULL;
+        *tail = node;
+        tail = &node->next;
     }
+    return batch;
 }
 
-// Frees all memory in the command queue
+// Frees all memory in a drained list of commands
 void free_command_queue(queued_command **head) {
     while (*head) {
         queued_command *temp = *head;
@@ -37,8 +94,14 @@ void free_command_queue(queued_command **head) {
     }
 }
 
+// Once the producers have stopped, a drain returns everything
+void command_queue_destroy(command_queue *q) {
+    queued_command *rest = command_queue_drain(q);
+    free_command_queue(&rest);
+}
+
 // Helper function to compare two command timestamps
-int compare_timestamps(const struct timespec *a, const struct timespec *b) {
+static int compare_timestamps(const struct timespec *a, const struct timespec *b) {
     if (a->tv_sec < b->tv_sec) {
         return -1;
     }
@@ -54,34 +117,107 @@ int compare_timestamps(const struct timespec *a, const struct timespec *b) {
     return 0;
 }
 
-// Sort the queue by timestamp
-void sort_command_queue(queued_command **head) {
-    if (!*head || !(*head)->next) {
-        return;
+// Restores the min-heap order below slot i by moving its command down past earlier ones
+static void sift_down(queued_command **heap, size_t count, size_t i) {
+    while (1) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && compare_timestamps(&heap[left]->timestamp, &heap[smallest]->timestamp) < 0) {
+            smallest = left;
+        }
+        if (right < count && compare_timestamps(&heap[right]->timestamp, &heap[smallest]->timestamp) < 0) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        queued_command *tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
     }
+}
+
+// Starts with no sources and no scratch heap
+void command_inbox_init(command_inbox *in) {
+    pthread_mutex_init(&in->lock, NULL);
+    in->sources = NULL;
+    in->heap = NULL;
+    in->heap_capacity = 0;
+}
+
+// Links a fresh source in at the front of the list
+command_source *command_inbox_open(command_inbox *in) {
+    command_source *source = malloc(sizeof(command_source));
+    command_queue_init(&source->queue);
+    atomic_init(&source->closed, false);
+    pthread_mutex_lock(&in->lock);
+    source->next = in->sources;
+    in->sources = source;
+    pthread_mutex_unlock(&in->lock);
+    return source;
+}
+
+// The release pairs with the drain's acquire, so every command pushed before closing is seen
+void command_source_close(command_source *source) {
+    atomic_store_explicit(&source->closed, true, memory_order_release);
+}
 
-    for (queued_command *i = *head; i; i = i->next) {
-        for (queued_command *j = i->next; j; j = j->next) {
-            if (compare_timestamps(&i->timestamp, &j->timestamp) > 0) {
-                // Swap all data fields
-                char *tmp_user = i->username;
-                char *tmp_role = i->role;
-                char *tmp_cmd = i->command_str;
-                uint64_t tmp_ver = i->client_version;
-                struct timespec tmp_time = i->timestamp;
-
-                i->username = j->username;
-                i->role = j-> role;
-                i->command_str = j->command_str;
-                i->client_version = j->client_version;
-                i->timestamp = j->timestamp;
-
-                j->username = tmp_user;
-                j->role = tmp_role;
-                j->command_str = tmp_cmd;
-                j->client_version = tmp_ver;
-                j->timestamp = tmp_time;
+// Drains each source into its own FIFO, then repeatedly takes the earliest head from the heap
+// and replaces it with the next command of the same FIFO
+queued_command *command_inbox_drain(command_inbox *in) {
+    size_t count = 0;
+    pthread_mutex_lock(&in->lock);
+    command_source **link = &in->sources;
+    while (*link) {
+        command_source *source = *link;
+        // Read closed first: a source closed by then has already pushed everything it ever will
+        bool closed = atomic_load_explicit(&source->closed, memory_order_acquire);
+        queued_command *fifo = command_queue_drain(&source->queue);
+        if (fifo) {
+            if (count == in->heap_capacity) {
+                in->heap_capacity = in->heap_capacity ? in->heap_capacity * 2 : INITIAL_HEAP_CAPACITY;
+                in->heap = realloc(in->heap, in->heap_capacity * sizeof(queued_command *));
             }
+            in->heap[count++] = fifo;
+        }
+        if (closed) {
+            *link = source->next;
+            free(source);
+        } else {
+            link = &source->next;
         }
     }
+    pthread_mutex_unlock(&in->lock);
+
+    for (size_t i = count / 2; i-- > 0; ) {
+        sift_down(in->heap, count, i);
+    }
+    queued_command *merged = NULL;
+    queued_command **tail = &merged;
+    while (count > 0) {
+        queued_command *earliest = in->heap[0];
+        *tail = earliest;
+        tail = &earliest->next;
+        in->heap[0] = earliest->next ? earliest->next : in->heap[--count];
+        sift_down(in->heap, count, 0);
+    }
+    return merged;
+}
+
+// Called at shutdown, after every client thread has gone
+void command_inbox_destroy(command_inbox *in) {
+    command_source *source = in->sources;
+    while (source) {
+        command_source *next = source->next;
+        command_queue_destroy(&source->queue);
+        free(source);
+        source = next;
+    }
+    in->sources = NULL;
+    free(in->heap);
+    in->heap = NULL;
+    in->heap_capacity = 0;
+    pthread_mutex_destroy(&in->lock);
 }
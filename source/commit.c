@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../libs/commit.h"
+#include "../libs/chunk_tree.h"
+#include "../libs/chunk_pool.h"
+#include "../libs/block_index.h"
+
+/*
+ * Accumulates output bytes into a private list of densely packed chunks
+ */
+typedef struct {
+    chunk_pool *pool; // Pool the new chunks are taken from
+    chunk *head; // First new chunk
+    chunk *tail; // Chunk currently being filled
+    size_t written; // Total bytes written
+} chunk_writer;
+
+// HELPER FUNCTIONS
+
+// Appends bytes to the writer, filling each chunk to CHUNK_SIZE before starting another
+static void writer_append(chunk_writer *w, const char *data, size_t len) {
+    w->written += len;
+    while (len > 0) {
+        if (!w->tail || w->tail->length == CHUNK_SIZE) {
+            chunk *c = chunk_pool_alloc(w->pool);
+            if (w->tail) {
+                w->tail->next = c;
+            } else {
+                w->head = c;
+            }
+            w->tail = c;
+        }
+        size_t space = CHUNK_SIZE - w->tail->length;
+        size_t to_copy = (len < space) ? len : space;
+        memcpy(w->tail->data + w->tail->length, data, to_copy);
+        w->tail->length += to_copy;
+        w->tail->newlines += count_newlines(data, to_copy);
+        chunk_hash_append(w->tail, data, to_copy);
+        data += to_copy;
+        len -= to_copy;
+    }
+}
+
+// Returns the first position (before the commit) the edit touches
+static size_t edit_start(const edit *e) {
+    return e->pos;
+}
+
+// Returns the last position (before the commit) the edit touches, clamped to the document
+static size_t edit_end(const edit *e, size_t doc_length) {
+    if (e->type == EDIT_INSERT || e->pos >= doc_length) {
+        return e->pos;
+    }
+    return (e->del_len > doc_length - e->pos) ? doc_length : e->pos + e->del_len;
+}
+
+// Merges two sorted edit lists, taking from the left list first on ties to keep the sort stable
+static edit *merge_edits(edit *a, edit *b) {
+    edit head;
+    edit *tail = &head;
+    while (a && b) {
+        if (edit_start(b) < edit_start(a)) {
+            tail->next = b;
+            b = b->next;
+        } else {
+            tail->next = a;
+            a = a->next;
+        }
+        tail = tail->next;
+    }
+    tail->next = a ? a : b;
+    return head.next;
+}
+
+// Rebuilds the chunks covering one cluster of overlapping edits [first, stop).
+// The cluster spans [cluster_start, cluster_end] and shift converts positions from
+// before the commit into the document as it is now. Returns the net change in length.
+static long long rebuild_run(document *doc, edit *first, edit *stop,
+                             size_t cluster_start, size_t cluster_end, long long shift) {
+    size_t length = doc->length;
+
+    // Widen the cluster to whole chunks
+    chunk *first_chunk = NULL;
+    chunk *last_chunk = NULL;
+    size_t run_start = 0;
+    size_t run_end = 0;
+    if (length > 0) {
+        size_t local;
+        size_t probe = (cluster_start < length) ? cluster_start : length - 1;
+        first_chunk = chunk_tree_find(doc, probe, &local);
+        run_start = probe - local;
+
+        probe = (cluster_end < length) ? cluster_end : length - 1;
+        last_chunk = chunk_tree_find(doc, probe, &local);
+        run_end = probe - local + last_chunk->length;
+    }
+
+    // Single forward sweep: copy old bytes, splice in inserts, skip deleted ranges
+    chunk_writer out = { &doc->pool, NULL, NULL, 0 };
+    chunk *src = first_chunk;
+    size_t src_off = 0;
+    size_t pos = run_start;
+    size_t deleted_until = run_start;
+    edit *e = first;
+    while (1) {
+        // Apply every edit that starts at this position, in queue order
+        while (e != stop && (size_t)((long long)e->pos + shift) == pos) {
+            if (e->type == EDIT_INSERT) {
+                writer_append(&out, e->text, strlen(e->text));
+            } else {
+                size_t end = (e->del_len > run_end - pos) ? run_end : pos + e->del_len;
+                if (end > deleted_until) {
+                    deleted_until = end;
+                }
+            }
+            e = e->next;
+        }
+        if (pos >= run_end) {
+            break;
+        }
+
+        // Advance to the next edit, the end of the deletion or the end of the run
+        size_t target = run_end;
+        if (e != stop && (size_t)((long long)e->pos + shift) < target) {
+            target = (size_t)((long long)e->pos + shift);
+        }
+        bool copying = (pos >= deleted_until);
+        if (!copying && deleted_until < target) {
+            target = deleted_until;
+        }
+        while (pos < target) {
+            while (src_off >= src->length) {
+                src = src->next;
+                src_off = 0;
+            }
+            size_t span = src->length - src_off;
+            if (span > target - pos) {
+                span = target - pos;
+            }
+            if (copying) {
+                writer_append(&out, src->data + src_off, span);
+            }
+            src_off += span;
+            pos += span;
+        }
+    }
+
+    // Swap the old run of chunks for the new ones (older snapshots keep the old run)
+    chunk_tree_replace(doc, run_start, run_end, out.head);
+
+    long long change = (long long)out.written - (long long)(run_end - run_start);
+    doc->length = (size_t)((long long)doc->length + change);
+
+    // A repack leaves the text unchanged, so only real edits touch the block index
+    if (first) {
+        block_index_update(doc, run_start, run_end, run_start + out.written);
+    }
+    return change;
+}
+
+// COMMIT
+
+// Top-down merge sort over the linked list (stable, O(k log k))
+edit *commit_sort_edits(edit *list) {
+    if (!list || !list->next) {
+        return list;
+    }
+
+    // Split the list in half with a slow/fast walk
+    edit *slow = list;
+    edit *fast = list->next;
+    while (fast && fast->next) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    edit *second = slow->next;
+    slow->next = NULL;
+
+    return merge_edits(commit_sort_edits(list), commit_sort_edits(second));
+}
+
+// Groups the sorted edits into clusters that overlap or touch and rebuilds each one left to right
+void commit_edits(document *doc, edit *sorted) {
+    size_t base_length = doc->length;
+    long long shift = 0; // Net length change from the clusters already rebuilt
+    edit *first = sorted;
+
+    while (first) {
+        size_t cluster_end = edit_end(first, base_length);
+        edit *stop = first->next;
+        while (stop && edit_start(stop) <= cluster_end) {
+            size_t end = edit_end(stop, base_length);
+            if (end > cluster_end) {
+                cluster_end = end;
+            }
+            stop = stop->next;
+        }
+        shift += rebuild_run(doc, first, stop,
+                             (size_t)((long long)edit_start(first) + shift),
+                             (size_t)((long long)cluster_end + shift), shift);
+        first = stop;
+    }
+}
+
+// A rebuild with no edits simply copies the run into fresh, full chunks
+void commit_repack(document *doc, size_t start, size_t end) {
+    rebuild_run(doc, NULL, NULL, start, end, 0);
+}
+
+// Packs the text into full chunks in one pass and links them after the (empty) document's tail
+void commit_load(document *doc, const char *data, size_t len) {
+    chunk_writer out = { &doc->pool, NULL, NULL, 0 };
+    writer_append(&out, data, len);
+
+    chunk_tree_replace(doc, doc->length, doc->length, out.head);
+    doc->length += len;
+    block_index_update(doc, 0, 0, len);
+}
@@ -0,0 +1,59 @@
+#include "../libs/compact.h"
+#include "../libs/chunk_tree.h"
+#include "../libs/commit.h"
+
+// Resumes at doc->compact_pos and merges runs of underfull neighbours until the budget is spent
+void compact_step(document *doc, size_t budget) {
+    if (doc->length == 0 || doc->underfull_chunks < 2) {
+        doc->compact_pos = 0;
+        return;
+    }
+
+    size_t pos = (doc->compact_pos < doc->length) ? doc->compact_pos : 0;
+    size_t local;
+    chunk *c = chunk_tree_find(doc, pos, &local);
+    pos -= local;
+
+    size_t visited = 0;
+    while (c && visited < budget) {
+        visited++;
+        if (c->length >= UNDERFULL_CHUNK_LEN || !c->next || c->next->length >= UNDERFULL_CHUNK_LEN) {
+            pos += c->length;
+            c = c->next;
+            continue;
+        }
+
+        // Extend the run over every adjacent underfull chunk (within the budget)
+        size_t run_chunks = 1;
+        size_t run_bytes = c->length;
+        chunk *last = c;
+        while (last->next && last->next->length < UNDERFULL_CHUNK_LEN && visited < budget) {
+            last = last->next;
+            run_chunks++;
+            run_bytes += last->length;
+            visited++;
+        }
+
+        // Repack only if the run fits in fewer chunks
+        size_t packed_chunks = (run_bytes + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        if (run_bytes > 0 && packed_chunks < run_chunks) {
+            commit_repack(doc, pos, pos + run_bytes - 1);
+            doc->compacted_chunks += run_chunks - packed_chunks;
+        }
+
+        // The run's chunks may have been replaced, so look the position up again
+        pos += run_bytes;
+        c = chunk_tree_find(doc, pos, &local);
+    }
+
+    doc->compact_pos = c ? pos : 0;
+}
+
+// Everything is maintained as chunks are linked and unlinked, so this just copies counters
+void compact_stats(const document *doc, fragmentation_stats *out) {
+    out->chunks = doc->chunk_count;
+    out->underfull_chunks = doc->underfull_chunks;
+    out->bytes = doc->length;
+    out->fill_ratio = doc->chunk_count ? (double)doc->length / ((double)doc->chunk_count * CHUNK_SIZE) : 1.0;
+    out->compacted_chunks = doc->compacted_chunks;
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../libs/durable.h"
+
+#define FNV32_PRIME 16777619u
+
+// FILE HELPERS
+
+// Loops until every byte is written, since write may stop part way
+int durable_write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// 32-bit FNV-1a, continued from a previous hash value
+uint32_t durable_checksum(uint32_t hash, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV32_PRIME;
+    }
+    return hash;
+}
+
+// A directory entry only survives a crash once the directory itself has been synced
+void durable_sync_parent_dir(const char *path) {
+    char dir[PATH_BUF_SIZE];
+    const char *slash = strrchr(path, '/');
+    if (slash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    } else {
+        strcpy(dir, ".");
+    }
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
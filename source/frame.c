@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "../libs/frame.h"
+
+_Static_assert(sizeof(frame_header) == 24, "frame header must not contain padding");
+_Static_assert(sizeof(frame_span) == 16, "frame span must not contain padding");
+
+// HELPER FUNCTIONS
+
+// Fills in a header
+static frame_header make_header(frame_opcode opcode, uint32_t user_id, uint64_t version, size_t len) {
+    frame_header h = { (uint32_t)opcode, user_id, version, (uint32_t)len, 0 };
+    return h;
+}
+
+// Writes every iovec, retrying after short writes and interrupts
+static int writev_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        // Skip what was written, which may end part way through an iovec
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+// ENCODING
+
+// Header and payload are copied in back to back
+void frame_append(byte_buffer *b, frame_opcode opcode, uint32_t user_id, uint64_t version, const void *payload, size_t len) {
+    frame_header h = make_header(opcode, user_id, version, len);
+    byte_buffer_reserve(b, sizeof(h) + len);
+    byte_buffer_append(b, &h, sizeof(h));
+    byte_buffer_append(b, payload, len);
+}
+
+// Frames follow the edit queue just as ops_format's lines do; an insert's span and text share one frame
+void frame_append_edits(byte_buffer *b, uint32_t user_id, const edit *first, bool commit) {
+    for (const edit *e = first; e; e = e->next) {
+        if (e->type == EDIT_INSERT) {
+            size_t len = strlen(e->text);
+            frame_span span = { e->pos, len };
+            frame_header h = make_header(FRAME_INSERT, user_id, 0, sizeof(span) + len);
+            byte_buffer_reserve(b, sizeof(h) + sizeof(span) + len);
+            byte_buffer_append(b, &h, sizeof(h));
+            byte_buffer_append(b, &span, sizeof(span));
+            byte_buffer_append(b, e->text, len);
+        } else {
+            frame_span span = { e->pos, e->del_len };
+            frame_append(b, FRAME_DELETE, user_id, 0, &span, sizeof(span));
+        }
+    }
+    if (commit) {
+        frame_append(b, FRAME_COMMIT, user_id, 0, NULL, 0);
+    }
+}
+
+// WRITING AND READING
+
+// Header and payload go out in one writev
+int frame_write(int fd, frame_opcode opcode, uint32_t user_id, uint64_t version, const void *payload, size_t len) {
+    frame_header h = make_header(opcode, user_id, version, len);
+    struct iovec iov[2] = {
+        { &h, sizeof(h) },
+        { (void *)payload, len }
+    };
+    return writev_all(fd, iov, len > 0 ? 2 : 1);
+}
+
+// The entries were encoded once for every binary client, so each one costs a single writev
+int frame_write_block(int fd, uint64_t version, uint64_t hash, const byte_buffer *entries) {
+    frame_header start = make_header(FRAME_VERSION, 0, version, sizeof(hash));
+    frame_header end = make_header(FRAME_END, 0, version, 0);
+    struct iovec iov[4] = {
+        { &start, sizeof(start) },
+        { &hash, sizeof(hash) },
+        { entries->data, entries->len },
+        { &end, sizeof(end) }
+    };
+    return writev_all(fd, iov, 4);
+}
+
+// The payload is read straight into the caller's buffer, which is only grown when too small
+bool frame_read(FILE *in, frame_header *h, char **payload, size_t *capacity, size_t max_len) {
+    if (fread(h, sizeof(*h), 1, in) != 1 || h->length > max_len) {
+        return false;
+    }
+    if (*capacity < (size_t)h->length + 1) {
+        *payload = realloc(*payload, (size_t)h->length + 1);
+        *capacity = (size_t)h->length + 1;
+    }
+    if (h->length > 0 && fread(*payload, 1, h->length, in) != h->length) {
+        return false;
+    }
+    (*payload)[h->length] = '\0';
+    return true;
+}
+
+// Lets a paste's text land in its final buffer without an intermediate copy
+bool frame_read_into(FILE *in, frame_header *h, char *dest, size_t max_len) {
+    if (fread(h, sizeof(*h), 1, in) != 1 || h->length > max_len) {
+        return false;
+    }
+    return h->length == 0 || fread(dest, 1, h->length, in) == h->length;
+}
+
+// Peeks one byte with the descriptor briefly non-blocking, then puts it back
+bool frame_poll(FILE *in) {
+    int fd = fileno(in);
+    int old_flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, old_flags | O_NONBLOCK);
+    int c = getc(in);
+    fcntl(fd, F_SETFL, old_flags);
+    if (c == EOF) {
+        clearerr(in); // Nothing has arrived yet; the next read must not see a stale error
+        return false;
+    }
+    ungetc(c, in);
+    return true;
+}
@@ -1,43 +1,247 @@
 #include "helper.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+/*
+ * How the arguments after a command's keyword are laid out
+ */
+typedef enum {
+    ARGS_POS, // <pos>
+    ARGS_POS_TEXT, // <pos> <text>
+    ARGS_LEVEL_POS, // <level> <pos>
+    ARGS_TWO, // <pos> <len> or <start> <end>
+    ARGS_TWO_TEXT, // <start> <end> <text>
+    ARGS_PASTE // <pos> <len> <exactly len bytes>
+} command_args;
+
+/*
+ * One row of the opcode table
+ */
+typedef struct {
+    const char *keyword; // Keyword the line starts with
+    size_t keyword_len; // strlen(keyword)
+    command_opcode opcode; // Opcode it maps to
+    command_args args; // Layout of its arguments
+} opcode_entry;
+
+static const opcode_entry opcode_table[] = {
+    { "INSERT", 6, CMD_INSERT, ARGS_POS_TEXT },
+    { "DEL", 3, CMD_DEL, ARGS_TWO },
+    { "NEWLINE", 7, CMD_NEWLINE, ARGS_POS },
+    { "HEADING", 7, CMD_HEADING, ARGS_LEVEL_POS },
+    { "BOLD", 4, CMD_BOLD, ARGS_TWO },
+    { "ITALIC", 6, CMD_ITALIC, ARGS_TWO },
+    { "BLOCKQUOTE", 10, CMD_BLOCKQUOTE, ARGS_POS },
+    { "ORDERED_LIST", 12, CMD_ORDERED_LIST, ARGS_POS },
+    { "UNORDERED_LIST", 14, CMD_UNORDERED_LIST, ARGS_POS },
+    { "CODE", 4, CMD_CODE, ARGS_TWO },
+    { "HORIZONTAL_RULE", 15, CMD_HORIZONTAL_RULE, ARGS_POS },
+    { "LINK", 4, CMD_LINK, ARGS_TWO_TEXT },
+    { "PASTE", 5, CMD_PASTE, ARGS_PASTE },
+};
+
+#define OPCODE_COUNT (sizeof(opcode_table) / sizeof(opcode_table[0]))
+
+// Finds the table row of an opcode
+static const opcode_entry *entry_for(command_opcode opcode) {
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (opcode_table[i].opcode == opcode) {
+            return &opcode_table[i];
+        }
+    }
+    return NULL;
+}
+
+// Skips spaces, then reads an unsigned decimal number and advances past it
+static bool read_number(const char **p, size_t *out) {
+    const char *s = *p;
+    while (*s == ' ') {
+        s++;
+    }
+    if (*s < '0' || *s > '9') {
+        return false;
+    }
+    size_t value = 0;
+    while (*s >= '0' && *s <= '9') {
+        size_t digit = (size_t)(*s - '0');
+        if (value > (SIZE_MAX - digit) / 10) {
+            return false; // Too large to be a position
+        }
+        value = value * 10 + digit;
+        s++;
+    }
+    *out = value;
+    *p = s;
+    return true;
+}
+
+// Reads a heading level, which may carry a sign (markdown_heading rejects the bad ones)
+static bool read_level(const char **p, int *out) {
+    const char *s = *p;
+    while (*s == ' ') {
+        s++;
+    }
+    bool negative = (*s == '-');
+    if (*s == '-' || *s == '+') {
+        s++;
+    }
+    size_t value;
+    if (!read_number(&s, &value) || value > INT_MAX) {
+        return false;
+    }
+    *out = negative ? -(int)value : (int)value;
+    *p = s;
+    return true;
+}
+
+// Calls the markdown function an opcode stands for
+static int execute_opcode(document *doc, const parsed_command *cmd, const char *text, uint64_t version) {
+    switch (cmd->opcode) {
+    case CMD_INSERT:
+    case CMD_PASTE:
+        return markdown_insert(doc, version, cmd->pos, text);
+    case CMD_DEL:
+        return markdown_delete(doc, version, cmd->pos, cmd->arg);
+    case CMD_NEWLINE:
+        return markdown_newline(doc, version, cmd->pos);
+    case CMD_HEADING:
+        return markdown_heading(doc, version, cmd->level, cmd->pos);
+    case CMD_BOLD:
+        return markdown_bold(doc, version, cmd->pos, cmd->arg);
+    case CMD_ITALIC:
+        return markdown_italic(doc, version, cmd->pos, cmd->arg);
+    case CMD_BLOCKQUOTE:
+        return markdown_blockquote(doc, version, cmd->pos);
+    case CMD_ORDERED_LIST:
+        return markdown_ordered_list(doc, version, cmd->pos);
+    case CMD_UNORDERED_LIST:
+        return markdown_unordered_list(doc, version, cmd->pos);
+    case CMD_CODE:
+        return markdown_code(doc, version, cmd->pos, cmd->arg);
+    case CMD_HORIZONTAL_RULE:
+        return markdown_horizontal_rule(doc, version, cmd->pos);
+    case CMD_LINK:
+        return markdown_link(doc, version, cmd->pos, cmd->arg, text);
+    default:
+        return UNKNOWN_COMMAND;
+    }
+}
+
+// Reads the keyword, then walks the line once, reading each argument where the table says it is
+bool command_parse(const char *line, parsed_command *cmd) {
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->opcode = CMD_UNKNOWN;
+
+    size_t keyword_len = strcspn(line, " ");
+    const opcode_entry *entry = NULL;
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (opcode_table[i].keyword_len == keyword_len && memcmp(line, opcode_table[i].keyword, keyword_len) == 0) {
+            entry = &opcode_table[i];
+            break;
+        }
+    }
+    if (!entry) {
+        return false;
+    }
+
+    const char *p = line + keyword_len;
+    bool ok;
+    switch (entry->args) {
+    case ARGS_POS:
+    case ARGS_POS_TEXT:
+        ok = read_number(&p, &cmd->pos);
+        break;
+    case ARGS_LEVEL_POS:
+        ok = read_level(&p, &cmd->level) && read_number(&p, &cmd->pos);
+        break;
+    default:
+        ok = read_number(&p, &cmd->pos) && read_number(&p, &cmd->arg);
+        break;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    // The text runs from the first non-space character to the end of the line and may not be empty
+    if (entry->args == ARGS_POS_TEXT || entry->args == ARGS_TWO_TEXT) {
+        while (*p == ' ') {
+            p++;
+        }
+        size_t text_len = strcspn(p, "\n");
+        if (text_len == 0) {
+            return false;
+        }
+        cmd->text_offset = (size_t)(p - line);
+        cmd->text_len = text_len;
+    }
+
+    // A paste's bytes follow a single space and are counted rather than ended by a newline
+    if (entry->args == ARGS_PASTE) {
+        if (*p != ' ' || cmd->arg == 0 || strnlen(p + 1, cmd->arg) != cmd->arg) {
+            return false;
+        }
+        cmd->text_offset = (size_t)(p + 1 - line);
+        cmd->text_len = cmd->arg;
+    }
+    cmd->opcode = entry->opcode;
+    return true;
+}
+
+// Dispatches on the opcode. Trailing text that already ends the line (always the case for a
+// paste) is used in place; otherwise it is copied to null terminate it, on the heap if it is
+// longer than a text-protocol line.
+int command_execute(document *doc, const char *line, const parsed_command *cmd, uint64_t version) {
+    const char *slice = line + cmd->text_offset;
+    if (slice[cmd->text_len] == '\0') {
+        return execute_opcode(doc, cmd, slice, version);
+    }
+    char short_text[MAX_COMMAND_SIZE];
+    char *text = (cmd->text_len < sizeof(short_text)) ? short_text : malloc(cmd->text_len + 1);
+    memcpy(text, slice, cmd->text_len);
+    text[cmd->text_len] = '\0';
+
+    int result = execute_opcode(doc, cmd, text, version);
+    if (text != short_text) {
+        free(text);
+    }
+    return result;
+}
+
+// Prints the arguments in the same layout command_parse reads them
+bool command_format(const char *line, const parsed_command *cmd, char *out, size_t out_size) {
+    const opcode_entry *entry = entry_for(cmd->opcode);
+    if (!entry) {
+        return (size_t)snprintf(out, out_size, "%s", line) < out_size;
+    }
+    int written;
+    switch (entry->args) {
+    case ARGS_POS:
+        written = snprintf(out, out_size, "%s %zu", entry->keyword, cmd->pos);
+        break;
+    case ARGS_POS_TEXT:
+        written = snprintf(out, out_size, "%s %zu %.*s", entry->keyword, cmd->pos,
+                           (int)cmd->text_len, line + cmd->text_offset);
+        break;
+    case ARGS_LEVEL_POS:
+        written = snprintf(out, out_size, "%s %d %zu", entry->keyword, cmd->level, cmd->pos);
+        break;
+    case ARGS_TWO:
+    case ARGS_PASTE:
+        written = snprintf(out, out_size, "%s %zu %zu", entry->keyword, cmd->pos, cmd->arg);
+        break;
+    default:
+        written = snprintf(out, out_size, "%s %zu %zu %.*s", entry->keyword, cmd->pos, cmd->arg,
+                           (int)cmd->text_len, line + cmd->text_offset);
+        break;
+    }
+    return written >= 0 && (size_t)written < out_size;
+}
 
 // Helper function used by server and client to parse and process commands
 int process_command(document *doc, const char *command_str, uint64_t client_version) {
-    size_t pos;
-    size_t start; 
-    size_t end;
-    int level;
-    size_t len;
-    char arg[MAX_COMMAND_SIZE];
-    char url[MAX_COMMAND_SIZE];
-
-    // Handle all markdown editing and formatting commands
-    if (sscanf(command_str, "INSERT %zu %[^\n]", &pos, arg) == 2) {
-        return markdown_insert(doc, client_version, pos, arg);
-    } else if (sscanf(command_str, "DEL %zu %zu", &pos, &len) == 2) {
-        return markdown_delete(doc, client_version, pos, len);
-    } else if (sscanf(command_str, "NEWLINE %zu", &pos) == 1) {
-        return markdown_newline(doc, client_version, pos);
-    } else if (sscanf(command_str, "HEADING %d %zu", &level, &pos) == 2) {
-        return markdown_heading(doc, client_version, level, pos);
-    } else if (sscanf(command_str, "BOLD %zu %zu", &start, &end) == 2) {
-        return markdown_bold(doc, client_version, start, end);
-    } else if (sscanf(command_str, "ITALIC %zu %zu", &start, &end) == 2) {
-        return markdown_italic(doc, client_version, start, end);
-    } else if (sscanf(command_str, "BLOCKQUOTE %zu", &pos) == 1) {
-        return markdown_blockquote(doc, client_version, pos);
-    } else if (sscanf(command_str, "ORDERED_LIST %zu", &pos) == 1) {
-        return markdown_ordered_list(doc, client_version, pos);
-    } else if (sscanf(command_str, "UNORDERED_LIST %zu", &pos) == 1) {
-        return markdown_unordered_list(doc, client_version, pos);
-    } else if (sscanf(command_str, "CODE %zu %zu", &start, &end) == 2) {
-        return markdown_code(doc, client_version, start, end);
-    } else if (sscanf(command_str, "HORIZONTAL_RULE %zu", &pos) == 1) {
-        return markdown_horizontal_rule(doc, client_version, pos);
-    } else if (sscanf(command_str, "LINK %zu %zu %[^\n]", &start, &end, url) == 3) {
-        return markdown_link(doc, client_version, start, end, url);
-    }
-
-    return UNKNOWN_COMMAND;
-}
\ No newline at end of file
+    parsed_command cmd;
+    command_parse(command_str, &cmd);
+    return command_execute(doc, command_str, &cmd, client_version);
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../libs/history.h"
+
+#define VERSION_PREFIX "VERSION "
+#define VERSION_PREFIX_LEN 8 // strlen("VERSION ")
+#define BASE_DECIMAL 10
+#define INITIAL_SEGMENT_CAPACITY 8 // First allocation for the segment and spill indexes
+
+// HELPER FUNCTIONS
+
+// Frees one broadcast block and its lines
+static void free_version_log(version_log *v) {
+    log_entry *e = v->entries;
+    while (e) {
+        log_entry *next = e->next;
+        free(e->line);
+        free(e);
+        e = next;
+    }
+    free(v);
+}
+
+// Writes one broadcast block in the format LOG? has always used
+static void print_block(const version_log *v, FILE *out) {
+    fprintf(out, "VERSION %llu %016llx\n", (unsigned long long)v->version_number, (unsigned long long)v->doc_hash);
+    for (const log_entry *e = v->entries; e; e = e->next) {
+        fprintf(out, "%s\n", e->line);
+    }
+    fprintf(out, "END\n");
+}
+
+// Returns the version of a segment's newest block
+static uint64_t segment_last_version(const log_segment *seg) {
+    return seg->ticks[seg->count - 1]->version_number;
+}
+
+// Writes the oldest in-memory segment to the spill file, indexes it and frees it
+static void spill_oldest(version_history *h) {
+    log_segment *seg = h->segments[0];
+    if (!h->spill) {
+        h->spill = fopen(h->spill_path, "w+");
+        if (!h->spill) {
+            perror("open history spill file");
+        }
+    }
+
+    if (h->spill) {
+        fseek(h->spill, 0, SEEK_END);
+        long offset = ftell(h->spill);
+        for (size_t i = 0; i < seg->count; i++) {
+            print_block(seg->ticks[i], h->spill);
+        }
+        fflush(h->spill);
+
+        if (h->spilled_count == h->spilled_capacity) {
+            h->spilled_capacity = h->spilled_capacity ? h->spilled_capacity * 2 : INITIAL_SEGMENT_CAPACITY;
+            h->spilled = realloc(h->spilled, h->spilled_capacity * sizeof(spilled_segment));
+        }
+        h->spilled[h->spilled_count++] = (spilled_segment){
+            seg->ticks[0]->version_number, segment_last_version(seg),
+            offset, (size_t)(ftell(h->spill) - offset), seg->first_index
+        };
+    } else {
+        h->origin_version = segment_last_version(seg); // The segment is lost, so catch-up must start after it
+    }
+
+    for (size_t i = 0; i < seg->count; i++) {
+        free_version_log(seg->ticks[i]);
+    }
+    free(seg);
+    h->segment_count--;
+    memmove(h->segments, h->segments + 1, h->segment_count * sizeof(log_segment *));
+}
+
+// Copies the blocks of a spilled segment with a version of at least from and a position below limit to out
+static void print_spilled(version_history *h, const spilled_segment *s, uint64_t from, size_t limit, FILE *out) {
+    char *buf = malloc(s->length + 1);
+    fseek(h->spill, s->offset, SEEK_SET);
+    size_t got = fread(buf, 1, s->length, h->spill);
+    buf[got] = '\0';
+
+    // Blocks start with "VERSION n"; only the first spilled segment printed can hold older ones
+    bool printing = true;
+    size_t index = s->first_index;
+    char *line = buf;
+    while (*line) {
+        char *end = strchr(line, '\n');
+        size_t len = end ? (size_t)(end - line) + 1 : strlen(line);
+        if (strncmp(line, VERSION_PREFIX, VERSION_PREFIX_LEN) == 0) {
+            if (index++ >= limit) {
+                break;
+            }
+            printing = strtoull(line + VERSION_PREFIX_LEN, NULL, BASE_DECIMAL) >= from;
+        }
+        if (printing) {
+            fwrite(line, 1, len, out);
+        }
+        line += len;
+    }
+    free(buf);
+}
+
+// HISTORY OPERATIONS
+
+// Nothing is allocated until the first block arrives
+void history_init(version_history *h, uint64_t origin_version, size_t retained_segments, const char *spill_path) {
+    pthread_mutex_init(&h->lock, NULL);
+    h->segments = NULL;
+    h->segment_count = 0;
+    h->segment_capacity = 0;
+    h->retained_segments = retained_segments ? retained_segments : 1;
+    h->spilled = NULL;
+    h->spilled_count = 0;
+    h->spilled_capacity = 0;
+    h->spill_path = spill_path;
+    h->spill = NULL;
+    h->appended = 0;
+    h->origin_version = origin_version;
+}
+
+// Fills the newest segment, starting another when it is full and spilling beyond the window
+void history_append(version_history *h, version_log *v) {
+    pthread_mutex_lock(&h->lock);
+    log_segment *tail = h->segment_count ? h->segments[h->segment_count - 1] : NULL;
+    if (!tail || tail->count == HISTORY_SEGMENT_TICKS) {
+        if (h->segment_count == h->segment_capacity) {
+            h->segment_capacity = h->segment_capacity ? h->segment_capacity * 2 : INITIAL_SEGMENT_CAPACITY;
+            h->segments = realloc(h->segments, h->segment_capacity * sizeof(log_segment *));
+        }
+        tail = malloc(sizeof(log_segment));
+        tail->count = 0;
+        tail->first_index = h->appended;
+        h->segments[h->segment_count++] = tail;
+        if (h->segment_count > h->retained_segments) {
+            spill_oldest(h);
+        }
+    }
+    tail->ticks[tail->count++] = v;
+    h->appended++;
+    pthread_mutex_unlock(&h->lock);
+}
+
+// Binary searches the spill index and the in-memory segments for the first block at or after from.
+void history_print(version_history *h, uint64_t from, size_t limit, FILE *out) {
+    pthread_mutex_lock(&h->lock);
+
+    size_t lo = 0;
+    size_t hi = h->spilled_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (h->spilled[mid].last_version < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (size_t i = lo; i < h->spilled_count; i++) {
+        print_spilled(h, &h->spilled[i], from, limit, out);
+    }
+
+    lo = 0;
+    hi = h->segment_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (segment_last_version(h->segments[mid]) < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (size_t i = lo; i < h->segment_count; i++) {
+        const log_segment *seg = h->segments[i];
+        for (size_t t = 0; t < seg->count && seg->first_index + t < limit; t++) {
+            if (seg->ticks[t]->version_number >= from) {
+                print_block(seg->ticks[t], out);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&h->lock);
+}
+
+// Counted under the lock so the result is consistent with concurrent appends
+size_t history_length(version_history *h) {
+    pthread_mutex_lock(&h->lock);
+    size_t appended = h->appended;
+    pthread_mutex_unlock(&h->lock);
+    return appended;
+}
+
+// Every block after origin_version is either in memory or in the spill file
+bool history_covers(version_history *h, uint64_t version) {
+    pthread_mutex_lock(&h->lock);
+    bool covered = version >= h->origin_version;
+    pthread_mutex_unlock(&h->lock);
+    return covered;
+}
+
+// The spill file only lives as long as the server run that wrote it
+void history_free(version_history *h) {
+    for (size_t i = 0; i < h->segment_count; i++) {
+        for (size_t t = 0; t < h->segments[i]->count; t++) {
+            free_version_log(h->segments[i]->ticks[t]);
+        }
+        free(h->segments[i]);
+    }
+    free(h->segments);
+    free(h->spilled);
+    if (h->spill) {
+        fclose(h->spill);
+        remove(h->spill_path);
+    }
+    pthread_mutex_destroy(&h->lock);
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../libs/journal.h"
+#include "../libs/helper.h"
+#include "../libs/ops.h"
+#include "../libs/durable.h"
+
+#define CHECKSUM_SKIP sizeof(uint32_t) // The checksum does not cover itself
+
+_Static_assert(sizeof(journal_record_header) == 24, "journal header must not contain padding");
+
+// HELPER FUNCTIONS
+
+// Checksums a header (minus its checksum field) followed by its payload
+static uint32_t record_checksum(const journal_record_header *h, const char *payload) {
+    uint32_t hash = durable_checksum(FNV32_OFFSET, (const char *)h + CHECKSUM_SKIP, sizeof(*h) - CHECKSUM_SKIP);
+    return durable_checksum(hash, payload, h->payload_len);
+}
+
+// Grows the batch buffer so it can take extra more bytes
+static void reserve(journal *j, size_t extra) {
+    if (j->len + extra <= j->capacity) {
+        return;
+    }
+    size_t capacity = j->capacity ? j->capacity : JOURNAL_INITIAL_CAPACITY;
+    while (capacity < j->len + extra) {
+        capacity *= 2;
+    }
+    j->buf = realloc(j->buf, capacity);
+    j->capacity = capacity;
+}
+
+// JOURNAL OPERATIONS
+
+// Appending only ever adds whole batches at the end of the file
+bool journal_open(journal *j, const char *path) {
+    j->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    j->buf = NULL;
+    j->len = 0;
+    j->capacity = 0;
+    if (j->fd < 0) {
+        perror("open journal");
+        return false;
+    }
+    off_t end = lseek(j->fd, 0, SEEK_END); // Replay has already cut off any torn tail
+    j->size = (end > 0) ? (size_t)end : 0;
+    return true;
+}
+
+// Serialises the record straight into the batch buffer. The header keeps lengths in 16 bits;
+// commands are limited to fit, but one that somehow does not is cut at UINT16_MAX here rather
+// than wrapped by the cast. Recovery replays such a record from its primitives.
+void journal_append(journal *j, uint64_t version, const char *user, const char *command, const char *ops) {
+    journal_record_header h;
+    size_t ops_len = ops ? strlen(ops) : 0;
+    size_t user_len = strlen(user);
+    size_t command_len = strlen(command);
+    h.user_len = (uint16_t)(user_len < UINT16_MAX ? user_len : UINT16_MAX);
+    h.command_len = (uint16_t)(command_len < UINT16_MAX ? command_len : UINT16_MAX);
+    h.payload_len = (uint32_t)(h.user_len + h.command_len + ops_len);
+    h.version = version;
+    h.kind = ops ? JOURNAL_OPS : JOURNAL_COMMAND;
+    h.reserved = 0;
+
+    reserve(j, sizeof(h) + h.payload_len);
+    char *payload = j->buf + j->len + sizeof(h);
+    memcpy(payload, user, h.user_len);
+    memcpy(payload + h.user_len, command, h.command_len);
+    if (ops_len > 0) {
+        memcpy(payload + h.user_len + h.command_len, ops, ops_len);
+    }
+    h.checksum = record_checksum(&h, payload);
+    memcpy(j->buf + j->len, &h, sizeof(h));
+    j->len += sizeof(h) + h.payload_len;
+}
+
+// One write and one fdatasync per broadcast tick, however many records it produced. After a
+// failure the file is cut back to the last durable record, so no later batch lands behind a torn one.
+int journal_flush(journal *j) {
+    if (j->len == 0) {
+        return 0;
+    }
+    if (durable_write_all(j->fd, j->buf, j->len) != 0 || fdatasync(j->fd) != 0) {
+        perror("journal flush");
+        if (ftruncate(j->fd, (off_t)j->size) != 0) {
+            perror("truncate journal");
+        }
+        return -1;
+    }
+    j->size += j->len;
+    j->len = 0;
+    return 0;
+}
+
+// Nothing buffered is lost on a clean shutdown
+void journal_close(journal *j) {
+    journal_flush(j);
+    if (j->fd >= 0) {
+        close(j->fd);
+    }
+    free(j->buf);
+    j->fd = -1;
+    j->buf = NULL;
+    j->len = j->capacity = 0;
+}
+
+// Appends go to the end of the file, so they restart from offset zero after this
+int journal_truncate(journal *j) {
+    if (ftruncate(j->fd, 0) != 0 || fdatasync(j->fd) != 0) {
+        perror("truncate journal");
+        return -1;
+    }
+    j->size = 0;
+    return 0;
+}
+
+// Only the file changes; records still buffered go to the new one
+int journal_rotate(journal *j, const char *path, const char *retired_path) {
+    if (rename(path, retired_path) != 0) {
+        perror("rotate journal");
+        return -1;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        perror("rotate journal");
+        if (rename(retired_path, path) != 0) {
+            perror("restore journal");
+        }
+        return -1;
+    }
+    durable_sync_parent_dir(path); // Records synced into the new file must not outlive its name
+    close(j->fd);
+    j->fd = fd;
+    j->size = 0;
+    return 0;
+}
+
+// RECOVERY
+
+// Maps the journal and re-applies each record newer than the document: primitives where the record
+// has them, otherwise the command itself against the version it was first applied to
+long journal_replay(const char *path, document *doc) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+    const char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    long applied = 0;
+    size_t offset = 0;
+    size_t group_start = 0; // First record of the group still waiting for its commit
+    long group_records = 0; // Records in that group (0 if none is open)
+    char user[LINE_LEN];
+    char *command = NULL; // Grown to the longest command seen (binary clients may exceed LINE_LEN)
+    size_t command_capacity = 0;
+    while (offset + sizeof(journal_record_header) <= size) {
+        journal_record_header h;
+        memcpy(&h, base + offset, sizeof(h));
+        const char *payload = base + offset + sizeof(h);
+        if (h.payload_len > size - offset - sizeof(h) ||
+            h.payload_len < (uint32_t)h.user_len + h.command_len ||
+            (h.kind == JOURNAL_COMMAND && h.payload_len != (uint32_t)h.user_len + h.command_len) ||
+            h.user_len >= LINE_LEN || (h.kind == JOURNAL_COMMAND && h.command_len >= LINE_LEN) ||
+            record_checksum(&h, payload) != h.checksum) {
+            break; // Torn or corrupt record: everything from here on is discarded
+        }
+
+        if ((h.kind == JOURNAL_COMMAND || h.kind == JOURNAL_OPS) && h.version > doc->version) {
+            memcpy(user, payload, h.user_len);
+            user[h.user_len] = '\0';
+            if (command_capacity < (size_t)h.command_len + 1) {
+                command = realloc(command, (size_t)h.command_len + 1);
+                command_capacity = (size_t)h.command_len + 1;
+            }
+            memcpy(command, payload + h.user_len, h.command_len);
+            command[h.command_len] = '\0';
+            size_t ops_offset = (size_t)h.user_len + h.command_len;
+            int result = (h.kind == JOURNAL_OPS)
+                       ? ops_apply(doc, payload + ops_offset, h.payload_len - ops_offset) // Commits at OP C
+                       : process_command(doc, command, doc->version);
+            if (result != SUCCESS) {
+                fprintf(stderr, "journal: %s's command \"%s\" no longer applies at version %llu\n",
+                        user, command, (unsigned long long)doc->version);
+                break;
+            }
+            if (h.kind == JOURNAL_COMMAND) {
+                markdown_increment_version(doc);
+            }
+            // A group-commit record leaves its primitives pending until the group's commit record
+            bool awaiting_commit = (h.kind == JOURNAL_OPS && doc->pending && doc->version + 1 == h.version);
+            if (awaiting_commit) {
+                if (group_records++ == 0) {
+                    group_start = offset;
+                }
+            } else {
+                group_records = 0;
+            }
+            if (doc->version != h.version && !awaiting_commit) {
+                fprintf(stderr, "journal: expected version %llu, replay reached %llu\n",
+                        (unsigned long long)h.version, (unsigned long long)doc->version);
+                break;
+            }
+            if (h.command_len > 0) {
+                applied++; // The record committing a group carries no command of its own
+            }
+        }
+        offset += sizeof(h) + h.payload_len;
+    }
+
+    munmap((void *)base, size);
+    free(command);
+
+    // A group cut short by a crash was never broadcast, so its edits are dropped with it
+    if (doc->pending) {
+        markdown_discard_pending(doc, NULL);
+        if (group_records > 0) {
+            applied -= group_records; // Every record in an open group carries a command
+            offset = group_start;
+        }
+    }
+    if (offset < size && ftruncate(fd, (off_t)offset) != 0) {
+        perror("truncate journal");
+    }
+    close(fd);
+    return applied;
+}
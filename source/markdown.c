@@ -6,6 +6,14 @@
 #include <ctype.h>
 
 #include "../libs/markdown.h"
+#include "../libs/chunk_tree.h"
+#include "../libs/chunk_pool.h"
+#include "../libs/commit.h"
+#include "../libs/range_set.h"
+#include "../libs/arena.h"
+#include "../libs/compact.h"
+#include "../libs/block_index.h"
+#include "../libs/scan.h"
 
 #define MAX_HEADING_LEVEL 3 // Maximum heading level is ###
 #define MAX_HEADING_LEN (MAX_HEADING_LEVEL + 2) // "### " + null terminator
@@ -23,38 +31,30 @@
 
 // HELPER FUNCTIONS
 
-// Finds the chunk containing a position and returns its local offset
+// Finds the chunk containing a position and returns its local offset (O(log n) via the chunk tree)
 chunk *find_chunk(document *doc, size_t pos, size_t *local_offset) {
-    chunk *current = doc->head;
-    size_t i = 0;
-
-    while (current && i + current->length <= pos) {
-        i += current->length;
-        current = current->next;
-    }
-
-    if (current) {
-        *local_offset = pos - i;
-    }
+    return chunk_tree_find(doc, pos, local_offset);
+}
 
-    return current;
+// Returns true if an ordered list prefix (e.g., "1. ") starts at the given position
+bool is_list_prefix_at(const document *doc, size_t pos) {
+    doc_cursor cur;
+    markdown_cursor_seek(&cur, doc, pos);
+    int digit = markdown_cursor_next(&cur);
+    return digit != EOF && isdigit(digit) &&
+           markdown_cursor_next(&cur) == '.' &&
+           markdown_cursor_next(&cur) == ' ';
 }
 
 // Checks if the position is near an existing ordered list prefix (e.g., "1. ")
-bool is_near_list_prefix(const char *text, size_t pos, size_t doc_length) {
+bool is_near_list_prefix(const document *doc, size_t pos) {
     // Check before cursor
-    if (pos >= LIST_PREFIX_LEN &&
-        isdigit(text[pos - LIST_PREFIX_LEN]) &&
-        text[pos - LIST_PREFIX_LEN + LIST_PREFIX_DOT_OFFSET] == '.' &&
-        text[pos - LIST_PREFIX_LEN + LIST_PREFIX_SPACE_OFFSET] == ' ') {
+    if (pos >= LIST_PREFIX_LEN && is_list_prefix_at(doc, pos - LIST_PREFIX_LEN)) {
         return true;
     }
 
     // Check at cursor
-    if (pos + LIST_PREFIX_LEN - 1 < doc_length &&
-        isdigit(text[pos]) &&
-        text[pos + LIST_PREFIX_DOT_OFFSET] == '.' &&
-        text[pos + LIST_PREFIX_SPACE_OFFSET] == ' ') {
+    if (pos + LIST_PREFIX_LEN - 1 < doc->length && is_list_prefix_at(doc, pos)) {
         return true;
     }
 
@@ -62,64 +62,40 @@ bool is_near_list_prefix(const char *text, size_t pos, size_t doc_length) {
 }
 
 // Returns true if the [start, end) range is entirely within a deleted region.
-bool is_fully_within_deleted(size_t start, size_t end, range *r) {
-    while (r) {
-        if (start >= r->start && end <= r->end) {
-            return true;
-        }
-        r = r->next;
-    }
-    return false;
+bool is_fully_within_deleted(size_t start, size_t end, const range_set *deleted) {
+    const range *r = range_set_floor(deleted, start);
+    return r && end <= r->end;
 }
 
 // Adjusts start/end positions if they fall within a deleted region
-void adjust_partially_deleted(size_t *start, size_t *end, range *r) {
-    while (r) {
-        // If start is inside a deleted range, snap to the closer edge
-        if (*start >= r->start && *start < r->end) {
-            *start = (*start - r->start <= r->end - *start) ? r->start : r->end;
-        }
-        // If end is inside a deleted range, snap to the closer edge
-        if (*end >= r->start && *end < r->end) {
-            *end = (*end - r->start <= r->end - *end) ? r->start : r->end;
-        }
-        r = r->next;
+void adjust_partially_deleted(size_t *start, size_t *end, const range_set *deleted) {
+    // If start is inside a deleted range, snap to the closer edge
+    const range *r = range_set_containing(deleted, *start);
+    if (r) {
+        *start = (*start - r->start <= r->end - *start) ? r->start : r->end;
     }
-}
-
-// Adjusts a single position if it falls within a deleted range
-size_t adjust_single_position_if_deleted(size_t pos, range *deleted) {
-    for (range *r = deleted; r; r = r->next) {
-        // If position is inside a deleted range, move to the start of that range
-        if (pos >= r->start && pos < r->end) {
-            return r->start;
-        }
+    // If end is inside a deleted range, snap to the closer edge
+    r = range_set_containing(deleted, *end);
+    if (r) {
+        *end = (*end - r->start <= r->end - *end) ? r->start : r->end;
     }
-    return pos;
 }
 
-// Builds a list of deleted ranges from the pending edit queue
-range *build_deleted_ranges(edit *pending) {
-    range *deleted = NULL;
-    for (edit *e = pending; e; e = e->next) {
-        if (e->type == EDIT_DELETE) {
-            range *r = malloc(sizeof(range));
-            r->start = e->pos;
-            r->end = e->pos + e->del_len;
-            r->next = deleted;
-            deleted = r;
-        }
-    }
-    return deleted;
+// Adjusts a single position if it falls within a deleted range
+size_t adjust_single_position_if_deleted(size_t pos, const range_set *deleted) {
+    // If position is inside a deleted range, move to the start of that range
+    const range *r = range_set_containing(deleted, pos);
+    return r ? r->start : pos;
 }
 
-// Frees a list of deleted ranges created by build_deleted_ranges()
-void free_deleted_ranges(range *deleted) {
-    while (deleted) {
-        range *next = deleted->next;
-        free(deleted);
-        deleted = next;
+// Appends an edit to the end of the pending edit queue in O(1)
+void append_pending(document *doc, edit *e) {
+    if (!doc->pending) {
+        doc->pending = e;
+    } else {
+        doc->pending_tail->next = e;
     }
+    doc->pending_tail = e;
 }
 
 // Returns true if the character before the given position is not a newline
@@ -127,10 +103,7 @@ bool needs_preceding_newline(const document *doc, size_t pos) {
     if (pos == 0) {
         return false;
     }
-    char *flat = markdown_flatten(doc);
-    bool result = (flat[pos - 1] != '\n');
-    free(flat);
-    return result;
+    return markdown_char_at(doc, pos - 1) != '\n';
 }
 
 // INITIALISATION AND FREE
@@ -142,28 +115,29 @@ document *markdown_init(void) {
     doc->length = 0; // Empty document
     doc->head = NULL; // No chunks yet
     doc->tail = NULL;
+    doc->root = NULL;
+    doc->tree_epoch = 0;
+    doc->seed = 2463534242u; // Any non-zero seed works for the priority generator
+    chunk_pool_init(&doc->pool);
+    doc->chunk_count = 0;
+    doc->underfull_chunks = 0;
+    doc->compact_pos = 0;
+    doc->compacted_chunks = 0;
     doc->pending = NULL;
+    doc->pending_tail = NULL;
+    arena_init(&doc->scratch);
+    range_set_init(&doc->deleted, &doc->scratch);
+    block_index_init(&doc->blocks);
     return doc;
 }
 
 void markdown_free(document *doc) {
-    // Free all chunks in the document
-    chunk *cur = doc->head;
-    while (cur) {
-        chunk *next = cur->next;
-        free(cur);
-        cur = next;
-    }
-    // Free all pending edits
-    edit *e = doc->pending;
-    while (e) {
-        edit *next = e->next;
-        if (e->text) {
-            free(e->text);
-        }
-        free(e);
-        e = next;
-    }
+    // Free all chunks in the document by releasing the pool's slabs
+    chunk_pool_destroy(&doc->pool);
+    // Free all pending edits, their text and the deleted ranges in one go
+    arena_destroy(&doc->scratch);
+    // Free the block index
+    block_index_free(&doc->blocks);
     free(doc); // Free the document itself
 }
 
@@ -177,95 +151,21 @@ int markdown_insert(document *doc, uint64_t version, size_t pos, const char *tex
     if (version != doc->version) {
         return OUTDATED_VERSION;
     }
-    // Create new edit node
-    edit *e = malloc(sizeof(edit));
+    // Create new edit node in the version's arena
+    edit *e = arena_alloc(&doc->scratch, sizeof(edit));
     e->type = EDIT_INSERT;
     e->pos = pos;
-    e->text = strdup(text);
+    e->text = arena_strdup(&doc->scratch, text);
     e->del_len = 0;
     e->next = NULL;
-    // Append to end of pending edit queue
-    if (!doc->pending) {
-        doc->pending = e;
-    } else {
-        edit *cur = doc->pending;
-        while (cur->next) {
-            cur = cur->next;
-        }
-        cur->next = e;
-    }
+    append_pending(doc, e);
     return SUCCESS;
 }
 
 // Applies an insert edit immediately to the document content
 void apply_insert(document *doc, size_t pos, const char *text) {
-    size_t len = strlen(text);
-    size_t inserted = 0;
-    size_t offset;
-    chunk *cur = find_chunk(doc, pos, &offset);
-    // If inserting at the end and no chunk exists, create one
-    if (!cur && pos == doc->length) {
-        cur = malloc(sizeof(chunk));
-        cur->length = 0;
-        cur->next = NULL;
-        cur->prev = doc->tail;
-        if (doc->tail) {
-            doc->tail->next = cur;
-        } else {
-            doc->head = cur;
-        }
-        doc->tail = cur;
-        offset = 0;
-    }
-    // Insert the text across one or more chunks
-    while (inserted < len) {
-         // If no chunk exists (e.g., middle insertion caused split), create one
-        if (!cur) {
-            cur = malloc(sizeof(chunk));
-            cur->length = 0;
-            cur->next = NULL;
-            cur->prev = doc->tail;
-            if (doc->tail) {
-                doc->tail->next = cur;
-            } else {
-                doc->head = cur;
-            }
-            doc->tail = cur;
-            offset = 0;
-        }
-        size_t space = CHUNK_SIZE - cur->length;
-        size_t to_copy = (len - inserted < space) ? (len - inserted) : space;
-
-        // Shift existing data to make room, if inserting in the middle
-        if (offset < cur->length) {
-            memmove(cur->data + offset + to_copy,
-                    cur->data + offset,
-                    cur->length - offset);
-        }
-
-        // Copy new data into the chunk
-        memcpy(cur->data + offset, text + inserted, to_copy);
-        cur->length += to_copy;
-        doc->length += to_copy;
-        inserted += to_copy;
-
-        // If the chunk is full, move to the next one (create if necessary)
-        if (cur->length == CHUNK_SIZE) {
-            offset = 0;
-            if (!cur->next) {
-                chunk *next = malloc(sizeof(chunk));
-                next->length = 0;
-                next->prev = cur;
-                next->next = NULL;
-                cur->next = next;
-                doc->tail = next;
-            }
-            cur = cur->next;
-        } else {
-            // Continue in same chunk
-            offset += to_copy;
-        }
-    }
+    edit e = { EDIT_INSERT, pos, (char *)text, 0, NULL };
+    commit_edits(doc, &e);
 }
 
 // Queues a delete operation starting at the given position for the specified length
@@ -276,67 +176,23 @@ int markdown_delete(document *doc, uint64_t version, size_t pos, size_t len) {
     if (version != doc->version) {
         return OUTDATED_VERSION;
     }
-    // Create and populate the delete edit node
-    edit *e = malloc(sizeof(edit));
+    // Create and populate the delete edit node in the version's arena
+    edit *e = arena_alloc(&doc->scratch, sizeof(edit));
     e->type = EDIT_DELETE;
     e->pos = pos;
     e->text = NULL;
     e->del_len = len;
     e->next = NULL;
-    // Append to the pending edit queue
-    if (!doc->pending) doc->pending = e;
-    else {
-        edit *cur = doc->pending;
-        while (cur->next) {
-            cur = cur->next;
-        }
-        cur->next = e;
-    }
+    // Record the deleted range so formatting commands can check against it
+    range_set_add(&doc->deleted, pos, (len > SIZE_MAX - pos) ? SIZE_MAX : pos + len);
+    append_pending(doc, e);
     return SUCCESS;
 }
 
 // Applies a delete operation by removing characters from the document starting at the given position
 void apply_delete(document *doc, size_t pos, size_t len) {
-    size_t offset;
-    chunk *cur = find_chunk(doc, pos, &offset);
-    size_t to_delete = len;
-    while (cur && to_delete > 0) {
-        // Determine how many characters can be deleted from this chunk
-        size_t can_delete = cur->length - offset;
-        if (can_delete > to_delete) can_delete = to_delete;
-
-        // Shift remaining data left to overwrite deleted portion
-        memmove(cur->data + offset,
-                cur->data + offset + can_delete,
-                cur->length - offset - can_delete);
-
-        cur->length -= can_delete;
-        doc->length -= can_delete;
-        to_delete -= can_delete;
-
-        chunk *next = cur->next;
-        
-        // If the current chunk is now empty, remove it from the list
-        if (cur->length == 0) {
-            if (cur->prev) {
-                cur->prev->next = cur->next;
-            } else {
-                doc->head = cur->next;
-            }
-            if (cur->next) {
-                cur->next->prev = cur->prev;
-            } else {
-                doc->tail = cur->prev;
-            }
-            free(cur);
-            cur = next;
-            offset = 0;
-        } else {
-            // Move to the next chunk
-            cur = next;
-            offset = 0;
-        }
-    }
+    edit e = { EDIT_DELETE, pos, NULL, len, NULL };
+    commit_edits(doc, &e);
 }
 
 // FORMATTING COMMANDS
@@ -349,9 +205,7 @@ int markdown_newline(document *doc, uint64_t version, size_t pos) {
     if (version != doc->version) {
         return OUTDATED_VERSION;
     }
-    range *deleted = build_deleted_ranges(doc->pending);
-    pos = adjust_single_position_if_deleted(pos, deleted);
-    free_deleted_ranges(deleted);
+    pos = adjust_single_position_if_deleted(pos, &doc->deleted);
 
     return markdown_insert(doc, version, pos, "\n");
 }
@@ -363,9 +217,7 @@ int markdown_heading(document *doc, uint64_t version, int level, size_t pos) {
     if (version != doc->version) {
         return OUTDATED_VERSION;
     }
-    range *deleted = build_deleted_ranges(doc->pending);
-    size_t adjusted = adjust_single_position_if_deleted(pos, deleted);
-    free_deleted_ranges(deleted);
+    size_t adjusted = adjust_single_position_if_deleted(pos, &doc->deleted);
 
     // Build heading prefix based on level
     char heading[MAX_HEADING_LEN];
@@ -392,13 +244,10 @@ int markdown_bold(document *doc, uint64_t version, size_t start, size_t end) {
         return OUTDATED_VERSION;
     }
 
-    range *deleted = build_deleted_ranges(doc->pending);
-    if (is_fully_within_deleted(start, end, deleted)) {
-        free_deleted_ranges(deleted);
+    if (is_fully_within_deleted(start, end, &doc->deleted)) {
         return DELETED_POSITION;
     }
-    adjust_partially_deleted(&start, &end, deleted);
-    free_deleted_ranges(deleted);
+    adjust_partially_deleted(&start, &end, &doc->deleted);
 
     // Insert closing tag first to preserve offsets
     if (markdown_insert(doc, version, end, "**") != 0)  {
@@ -420,14 +269,10 @@ int markdown_italic(document *doc, uint64_t version, size_t start, size_t end) {
         return OUTDATED_VERSION;
     }
 
-    range *deleted = build_deleted_ranges(doc->pending);
-
-    if (is_fully_within_deleted(start, end, deleted)) {
-        free_deleted_ranges(deleted);
+    if (is_fully_within_deleted(start, end, &doc->deleted)) {
         return DELETED_POSITION;
     }
-    adjust_partially_deleted(&start, &end, deleted);
-    free_deleted_ranges(deleted);
+    adjust_partially_deleted(&start, &end, &doc->deleted);
     // Insert closing tag first to preserve original offsets
     if (markdown_insert(doc, version, end, "*") != 0)  {
         return INSERT_FAILED;
@@ -448,9 +293,7 @@ int markdown_blockquote(document *doc, uint64_t version, size_t pos) {
         return OUTDATED_VERSION;
     }
 
-    range *deleted = build_deleted_ranges(doc->pending);
-    size_t adjusted = adjust_single_position_if_deleted(pos, deleted);
-    free_deleted_ranges(deleted);
+    size_t adjusted = adjust_single_position_if_deleted(pos, &doc->deleted);
 
     // Add newline before "> " if inserting mid-line
     if (needs_preceding_newline(doc, adjusted)) {
@@ -476,43 +319,23 @@ int markdown_ordered_list(document *doc, uint64_t version, size_t pos) {
     }
 
     // Adjust for deleted regions
-    range *deleted = build_deleted_ranges(doc->pending);
-    pos = adjust_single_position_if_deleted(pos, deleted);
-    free_deleted_ranges(deleted);
+    pos = adjust_single_position_if_deleted(pos, &doc->deleted);
 
-    char *text = markdown_flatten(doc);
     // Reject insertion if already near an existing list prefix
-    if (is_near_list_prefix(text, pos, doc->length)) {
-        free(text);
+    if (is_near_list_prefix(doc, pos)) {
         return -1;
     }
 
     // Step 1: Determine what number this list item should be
-    size_t line_start = pos;
-    while (line_start > 0 && text[line_start - 1] != '\n') {
-        line_start--;
-    }
+    size_t line_start = markdown_line_start(doc, pos);
     int number = 1;
-    // Scan upward to find the most recent ordered list number
-    size_t scan = line_start;
-    while (scan > 0) {
-        size_t line = scan;
-        while (line > 0 && text[line - 1] != '\n') {
-            line--;
-        }
-        if (isdigit(text[line]) && 
-            text[line + LIST_PREFIX_DOT_OFFSET] == '.' && 
-            text[line + LIST_PREFIX_SPACE_OFFSET] == ' ') {
-            number = text[line] - '0' + 1;
-            break;
-        }
-        if (line == 0) {
-            break;
-        }
-        scan = line - 1;
+    // Look up the most recent ordered list item at or above this line
+    const block *previous = (line_start > 0)
+        ? block_index_last_before(&doc->blocks, BLOCK_ORDERED_ITEM, line_start) : NULL;
+    if (previous) {
+        number = previous->level + 1;
     }
     if (number > MAX_LIST_ITEM_NUMBER) {
-        free(text);
         return -1;
     }
     char prefix[BUF_SIZE];
@@ -523,35 +346,22 @@ int markdown_ordered_list(document *doc, uint64_t version, size_t pos) {
     }
 
     if (markdown_insert(doc, version, pos, prefix) != 0) {
-        free(text);
         return INSERT_FAILED;
     }
 
-    // Step 3: Re-flatten document to reflect new insertion
-    free(text);
-    text = markdown_flatten(doc);
-
-    // Step 4: Walk forward to renumber any subsequent list items
+    // Step 2: Walk forward to renumber any subsequent list items
     size_t cursor = pos + strlen(prefix);
     int renumber = number + 1;
 
     while (renumber <= MAX_LIST_ITEM_NUMBER && cursor < doc->length) {
         // Find start of next line
-        size_t line_start = cursor;
-        while (line_start < doc->length && text[line_start] != '\n') {
-            line_start++;
-        }
-        if (line_start >= doc->length) break;
-
-        size_t next_line = line_start + 1;
+        size_t next_line = markdown_next_line_start(doc, cursor);
         if (next_line + LIST_PREFIX_SPACE_OFFSET >= doc->length) {
             break;
         }
 
-        // Check if the next line starts with a valid list prefix
-        if (isdigit(text[next_line]) && 
-            text[next_line + LIST_PREFIX_DOT_OFFSET] == '.' && 
-            text[next_line + LIST_PREFIX_SPACE_OFFSET] == ' ') {
+        // Check if the next line is an ordered list item
+        if (block_index_at(&doc->blocks, BLOCK_ORDERED_ITEM, next_line)) {
             // Overwrite current prefix with new renumbered one
             if (markdown_delete(doc, doc->version, next_line, LIST_PREFIX_LEN) != 0) {
                 break;
@@ -565,15 +375,11 @@ int markdown_ordered_list(document *doc, uint64_t version, size_t pos) {
 
             renumber++;
             cursor = next_line + strlen(new_prefix);
-
-            free(text);
-            text = markdown_flatten(doc);
         } else {
             break; // No more list items to renumber
         }
     }
 
-    free(text);
     return SUCCESS;
 }
 
@@ -586,16 +392,9 @@ int markdown_unordered_list(document *doc, uint64_t version, size_t pos) {
         return OUTDATED_VERSION;
     }
 
-    range *deleted = build_deleted_ranges(doc->pending);
-    size_t adjusted = adjust_single_position_if_deleted(pos, deleted);
-    free_deleted_ranges(deleted);
+    size_t adjusted = adjust_single_position_if_deleted(pos, &doc->deleted);
 
-    char *flat = markdown_flatten(doc);
-    if (!flat) {
-        return -1;
-    }
-    bool need_newline = (adjusted > 0 && flat[adjusted - 1] != '\n');
-    free(flat);
+    bool need_newline = needs_preceding_newline(doc, adjusted);
     if (need_newline) {
         if (markdown_insert(doc, version, adjusted, "\n- ") != 0) {
             return INSERT_FAILED;
@@ -619,13 +418,10 @@ int markdown_code(document *doc, uint64_t version, size_t start, size_t end) {
         return OUTDATED_VERSION;
     }
 
-    range *deleted = build_deleted_ranges(doc->pending);
-    if (is_fully_within_deleted(start, end, deleted)) {
-        free_deleted_ranges(deleted);
+    if (is_fully_within_deleted(start, end, &doc->deleted)) {
         return DELETED_POSITION;
     }
-    adjust_partially_deleted(&start, &end, deleted);
-    free_deleted_ranges(deleted);
+    adjust_partially_deleted(&start, &end, &doc->deleted);
 
     if (markdown_insert(doc, version, end, "`") != 0) {
         return INSERT_FAILED;
@@ -646,14 +442,10 @@ int markdown_horizontal_rule(document *doc, uint64_t version, size_t pos) {
         return OUTDATED_VERSION;
     }
 
-    range *deleted = build_deleted_ranges(doc->pending);
-    size_t adjusted = adjust_single_position_if_deleted(pos, deleted);
-    free_deleted_ranges(deleted);
+    size_t adjusted = adjust_single_position_if_deleted(pos, &doc->deleted);
 
-    char *flat = markdown_flatten(doc);
-    bool need_prefix_newline = (adjusted > 0 && flat[adjusted - 1] != '\n');
-    bool need_suffix_newline = (adjusted == doc->length || flat[adjusted] != '\n');
-    free(flat);
+    bool need_prefix_newline = needs_preceding_newline(doc, adjusted);
+    bool need_suffix_newline = (markdown_char_at(doc, adjusted) != '\n');
 
     // Build appropriate string to insert based on surrounding content (i.e. add newlines if required)
     char buffer[BUF_SIZE];
@@ -683,30 +475,24 @@ int markdown_link(document *doc, uint64_t version, size_t start, size_t end, con
         return OUTDATED_VERSION;
     }
 
-    range *deleted = build_deleted_ranges(doc->pending);
-    if (is_fully_within_deleted(start, end, deleted)) {
-        free_deleted_ranges(deleted);
+    if (is_fully_within_deleted(start, end, &doc->deleted)) {
         return DELETED_POSITION;
     }
-    adjust_partially_deleted(&start, &end, deleted);
-    free_deleted_ranges(deleted);
+    adjust_partially_deleted(&start, &end, &doc->deleted);
 
     // Create closing string: "](url)"
     size_t url_len = strlen(url);
     size_t link_buf_size = url_len + LINK_SUFFIX_FORMAT_LEN;
-    char *closing = malloc(link_buf_size);
+    char *closing = arena_alloc(&doc->scratch, link_buf_size);
     snprintf(closing, link_buf_size, "](%s)", url);
     // Insert link markers
     if (markdown_insert(doc, version, start, "[") != 0) {
-        free(closing);
         return INSERT_FAILED;
     }
     if (markdown_insert(doc, version, end, closing) != 0) {
-        free(closing);
         return INSERT_FAILED;
     }
 
-    free(closing);
     return SUCCESS;
 }
 
@@ -714,12 +500,144 @@ int markdown_link(document *doc, uint64_t version, size_t start, size_t end, con
 
 // Prints the current state of the document to the given output stream
 void markdown_print(const document *doc, FILE *stream) {
-    char *flattened = markdown_flatten(doc);
-    if (flattened == NULL) {
-        return;
+    doc_cursor cur;
+    const char *data;
+    size_t len;
+    markdown_cursor_seek(&cur, doc, 0);
+    while ((len = markdown_cursor_span(&cur, &data)) > 0) {
+        fwrite(data, 1, len, stream);
     }
-    fprintf(stream, "%s", flattened);
-    free(flattened);
+}
+
+// Prints one line per indexed block in document order: "<TYPE> <position>", followed by the
+// heading level or item number where the block has one
+void markdown_outline(const document *doc, FILE *stream) {
+    size_t next[BLOCK_TYPE_COUNT] = { 0 };
+    while (1) {
+        // Pick the type whose next block comes first
+        int best = -1;
+        for (int t = 0; t < BLOCK_TYPE_COUNT; t++) {
+            const block_list *list = &doc->blocks.lists[t];
+            if (next[t] < list->count &&
+                (best < 0 || list->items[next[t]].start < doc->blocks.lists[best].items[next[best]].start)) {
+                best = t;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        const block *b = &doc->blocks.lists[best].items[next[best]++];
+        if (best == BLOCK_HEADING || best == BLOCK_ORDERED_ITEM) {
+            fprintf(stream, "%s %zu %d\n", block_type_name((block_type)best), b->start, b->level);
+        } else {
+            fprintf(stream, "%s %zu\n", block_type_name((block_type)best), b->start);
+        }
+    }
+}
+
+// Skips over any empty chunks so the cursor always rests on a readable character (or the end)
+static void cursor_normalise(doc_cursor *cur) {
+    while (cur->chunk && cur->offset >= cur->chunk->length) {
+        cur->chunk = cur->chunk->next;
+        cur->offset = 0;
+    }
+}
+
+// Positions a cursor at the given document position (clamped to the end of the document)
+void markdown_cursor_seek(doc_cursor *cur, const document *doc, size_t pos) {
+    cur->doc = doc;
+    cur->chunk = chunk_tree_find(doc, pos, &cur->offset);
+    cur->pos = cur->chunk ? pos : doc->length;
+    if (!cur->chunk) {
+        cur->offset = 0;
+    }
+}
+
+// Returns the character under the cursor without moving it, or EOF at the end of the document
+int markdown_cursor_peek(const doc_cursor *cur) {
+    return cur->chunk ? (unsigned char)cur->chunk->data[cur->offset] : EOF;
+}
+
+// Returns the character under the cursor and advances past it, or EOF at the end of the document
+int markdown_cursor_next(doc_cursor *cur) {
+    if (!cur->chunk) {
+        return EOF;
+    }
+    int c = (unsigned char)cur->chunk->data[cur->offset];
+    cur->offset++;
+    cur->pos++;
+    cursor_normalise(cur);
+    return c;
+}
+
+// Steps the cursor back one character and returns it, or EOF at the start of the document
+int markdown_cursor_prev(doc_cursor *cur) {
+    if (cur->pos == 0) {
+        return EOF;
+    }
+    if (cur->chunk && cur->offset > 0) {
+        cur->offset--;
+    } else {
+        // Move to the last character of the previous non-empty chunk
+        const chunk *c = cur->chunk ? cur->chunk->prev : cur->doc->tail;
+        while (c && c->length == 0) {
+            c = c->prev;
+        }
+        cur->chunk = c;
+        cur->offset = c->length - 1;
+    }
+    cur->pos--;
+    return (unsigned char)cur->chunk->data[cur->offset];
+}
+
+// Exposes the contiguous bytes from the cursor to the end of its chunk and advances past them.
+// Returns the number of bytes in the span (0 at the end of the document).
+size_t markdown_cursor_span(doc_cursor *cur, const char **data) {
+    if (!cur->chunk) {
+        *data = NULL;
+        return 0;
+    }
+    size_t len = cur->chunk->length - cur->offset;
+    *data = cur->chunk->data + cur->offset;
+    cur->pos += len;
+    cur->offset = cur->chunk->length;
+    cursor_normalise(cur);
+    return len;
+}
+
+// Returns the character at the given position, or EOF if it is past the end of the document
+int markdown_char_at(const document *doc, size_t pos) {
+    size_t offset;
+    const chunk *c = chunk_tree_find(doc, pos, &offset);
+    return c ? (unsigned char)c->data[offset] : EOF;
+}
+
+// Returns the position where the line containing pos begins (just after the previous newline).
+// The chunk holding pos usually holds that newline too, so it is scanned backwards first; only
+// a line that starts in an earlier chunk costs the two descents by newline count.
+size_t markdown_line_start(const document *doc, size_t pos) {
+    size_t offset;
+    const chunk *c = chunk_tree_find(doc, pos, &offset);
+    if (c) {
+        const char *nl = scan->find_last_newline(c->data, offset);
+        if (nl) {
+            return pos - offset + (size_t)(nl - c->data) + 1;
+        }
+    }
+    size_t before = chunk_tree_newlines_before(doc, pos);
+    if (before == 0) {
+        return 0;
+    }
+    return chunk_tree_find_newline(doc, before - 1) + 1;
+}
+
+// Returns the position just after the first newline at or after pos, or the document length if there is none
+size_t markdown_next_line_start(const document *doc, size_t pos) {
+    size_t before = chunk_tree_newlines_before(doc, pos);
+    if (doc->root == NULL || before >= doc->root->subtree_newlines) {
+        return doc->length;
+    }
+    return chunk_tree_find_newline(doc, before) + 1;
 }
 
 // Returns a newly allocated string containing the full document text as a flat buffer
@@ -738,73 +656,39 @@ char *markdown_flatten(const document *doc) {
 }
 
 // VERSIONING
-// Applies all pending edits (in the form of inserts and deletes) to the document and increments its version
+// Applies all pending edits (in the form of inserts and deletes) to the document and increments its version.
+// Every edit position refers to the current version; the edits are sorted once and merged into
+// the chunks in a single forward sweep.
 void markdown_increment_version(document *doc) {
-    edit *e = doc->pending;
+    edit *sorted = commit_sort_edits(doc->pending);
+    commit_edits(doc, sorted);
 
-    // Separate deletes and inserts into two lists
-    edit *deletes = NULL;
-    edit *inserts = NULL;
-    while (e) {
-        edit *next = e->next;
-        if (e->type == EDIT_DELETE) {
-            e->next = deletes;
-            deletes = e;
-        } else if (e->type == EDIT_INSERT) {
-            e->next = inserts;
-            inserts = e;
-        }
-        e = next;
-    }
-
-    // Apply all delete edits
-    for (edit *d = deletes; d; d = d->next) {
-        apply_delete(doc, d->pos, d->del_len);
-    }
+    // Release the applied edits, their text and the deleted ranges without visiting them
+    arena_reset(&doc->scratch);
+    range_set_clear(&doc->deleted);
+    doc->pending = NULL;
+    doc->pending_tail = NULL;
+    doc->version++; // Increment the document version
 
-    // Count insert operations
-    int count = 0;
-    for (edit *i = inserts; i; i = i->next) count++;
+    // Spend a bounded amount of work merging underfull chunks left behind by edits
+    compact_step(doc, COMPACT_STEP_BUDGET);
+}
 
-    // Copy insert edits into an array for sorting
-    edit **insert_array = malloc(sizeof(edit *) * count);
-    int idx = 0;
-    for (edit *i = inserts; i; i = i->next) {
-        insert_array[idx++] = i;
+// Drops the pending edits queued after mark (all of them if mark is NULL), so a command rejected
+// part way through leaves nothing behind. The deleted ranges are rebuilt from the edits that remain;
+// the dropped edits' memory is reclaimed with the rest of the arena at the next commit.
+void markdown_discard_pending(document *doc, edit *mark) {
+    if (mark) {
+        mark->next = NULL;
+        doc->pending_tail = mark;
+    } else {
+        doc->pending = NULL;
+        doc->pending_tail = NULL;
     }
-
-    // Sort inserts by position in ascending order
-    for (int i = 1; i < count; i++) {
-        edit *key = insert_array[i];
-        int j = i - 1;
-        while (j >= 0 && insert_array[j]->pos > key->pos) {
-            insert_array[j + 1] = insert_array[j];
-            j--;
+    range_set_clear(&doc->deleted);
+    for (edit *e = doc->pending; e; e = e->next) {
+        if (e->type == EDIT_DELETE) {
+            range_set_add(&doc->deleted, e->pos, (e->del_len > SIZE_MAX - e->pos) ? SIZE_MAX : e->pos + e->del_len);
         }
-        insert_array[j + 1] = key;
-    }
-
-    // Apply inserts, adjusting for position shifts due to prior inserts
-    size_t offset = 0;
-    for (int i = 0; i < count; i++) {
-        size_t adjusted_pos = insert_array[i]->pos + offset;
-        apply_insert(doc, adjusted_pos, insert_array[i]->text);
-        offset += strlen(insert_array[i]->text);
     }
-
-    // Free delete edits
-    for (edit *d = deletes; d;) {
-        edit *next = d->next;
-        free(d);
-        d = next;
-    }
-    // Free insert edits and their text
-    for (int i = 0; i < count; i++) {
-        free(insert_array[i]->text);
-        free(insert_array[i]);
-    }
-    free(insert_array);
-
-    doc->pending = NULL;
-    doc->version++; // Increment the document version
-}
\ No newline at end of file
+}
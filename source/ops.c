@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libs/ops.h"
+#include "../libs/byte_buffer.h"
+
+#define ESCAPED_BYTE_LEN 4 // Longest escape, "\xHH"
+#define OP_HEADER_LEN 64 // "OP I <pos> <len> " with room to spare
+#define ASCII_PRINT_MIN 32
+#define ASCII_PRINT_MAX 126
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// HELPER FUNCTIONS
+
+// Appends an escaped copy of text so it fits on one line. Escapes are stored byte by byte
+// with no terminator, so each input byte takes at most ESCAPED_BYTE_LEN bytes.
+static void append_escaped(byte_buffer *b, const char *text, size_t len) {
+    byte_buffer_reserve(b, len * ESCAPED_BYTE_LEN);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '\\') {
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = '\\';
+        } else if (c == '\n') {
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = 'n';
+        } else if (c < ASCII_PRINT_MIN || c > ASCII_PRINT_MAX) {
+            b->data[b->len++] = '\\';
+            b->data[b->len++] = 'x';
+            b->data[b->len++] = HEX_DIGITS[c >> 4];
+            b->data[b->len++] = HEX_DIGITS[c & 0xf];
+        } else {
+            b->data[b->len++] = (char)c;
+        }
+    }
+}
+
+// Decodes an escaped insert text into out, which must hold len bytes. Returns the bytes
+// decoded, which only matches len if the text was intact.
+static size_t unescape(const char *in, char *out, size_t len) {
+    size_t n = 0;
+    while (*in && n < len) {
+        if (*in != '\\') {
+            out[n++] = *in++;
+        } else if (in[1] == '\\' || in[1] == 'n') {
+            out[n++] = (in[1] == 'n') ? '\n' : '\\';
+            in += 2;
+        } else if (in[1] == 'x' && in[2] && in[3]) {
+            char hex[3] = { in[2], in[3], '\0' };
+            out[n++] = (char)strtoul(hex, NULL, 16);
+            in += 4;
+        } else {
+            return 0;
+        }
+    }
+    return *in ? 0 : n;
+}
+
+// PRIMITIVES
+
+// One line per edit, in queue order, so the receiver's stable sort reproduces the commit exactly
+char *ops_format(const edit *first, bool commit) {
+    byte_buffer b = { NULL, 0, 0 };
+    for (const edit *e = first; e; e = e->next) {
+        byte_buffer_reserve(&b, OP_HEADER_LEN);
+        if (e->type == EDIT_INSERT) {
+            size_t len = strlen(e->text);
+            b.len += (size_t)sprintf(b.data + b.len, "OP I %zu %zu ", e->pos, len);
+            append_escaped(&b, e->text, len);
+        } else {
+            b.len += (size_t)sprintf(b.data + b.len, "OP D %zu %zu", e->pos, e->del_len);
+        }
+        byte_buffer_reserve(&b, 1); // The separator, which the header reservation may not cover
+        b.data[b.len++] = '\n';
+    }
+    byte_buffer_reserve(&b, sizeof(OPS_COMMIT_LINE));
+    if (commit) {
+        memcpy(b.data + b.len, OPS_COMMIT_LINE, sizeof(OPS_COMMIT_LINE)); // Includes the terminator
+    } else {
+        if (b.len > 0) {
+            b.len--; // Drop the last separator
+        }
+        b.data[b.len] = '\0';
+    }
+    return b.data;
+}
+
+// Queues through markdown_insert/markdown_delete so the edits follow the normal commit path
+int ops_apply_line(document *doc, const char *line) {
+    size_t pos, len;
+    int consumed = 0;
+    if (strcmp(line, OPS_COMMIT_LINE) == 0) {
+        markdown_increment_version(doc);
+        return SUCCESS;
+    }
+    // The text starts after exactly one space and is never shorter escaped than decoded
+    if (sscanf(line, "OP I %zu %zu%n", &pos, &len, &consumed) == 2 && line[consumed] == ' ' &&
+        len > 0 && len <= strlen(line + consumed + 1)) {
+        char *text = malloc(len + 1);
+        int result = INVALID_CURSOR_POS;
+        if (unescape(line + consumed + 1, text, len) == len) {
+            text[len] = '\0';
+            result = markdown_insert(doc, doc->version, pos, text);
+        }
+        free(text);
+        return result;
+    }
+    if (sscanf(line, "OP D %zu %zu%n", &pos, &len, &consumed) == 2 && line[consumed] == '\0') {
+        return markdown_delete(doc, doc->version, pos, len);
+    }
+    return INVALID_CURSOR_POS;
+}
+
+// Splits on '\n'; escaped insert text never contains one
+int ops_apply(document *doc, const char *ops, size_t len) {
+    char line[OP_HEADER_LEN];
+    char *long_line = NULL;
+    size_t offset = 0;
+    int result = SUCCESS;
+    while (offset < len && result == SUCCESS) {
+        const char *end = memchr(ops + offset, '\n', len - offset);
+        size_t line_len = end ? (size_t)(end - (ops + offset)) : len - offset;
+        char *buf = line;
+        if (line_len >= sizeof(line)) {
+            long_line = realloc(long_line, line_len + 1);
+            buf = long_line;
+        }
+        memcpy(buf, ops + offset, line_len);
+        buf[line_len] = '\0';
+        result = ops_apply_line(doc, buf);
+        offset += line_len + 1;
+    }
+    free(long_line);
+    return result;
+}
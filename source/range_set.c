@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libs/range_set.h"
+#include "../libs/arena.h"
+
+#define RANGE_SET_INITIAL_CAPACITY 8
+
+// HELPER FUNCTIONS
+
+// Returns the number of ranges whose start is at or before pos (binary search)
+static size_t count_starting_by(const range_set *set, size_t pos) {
+    size_t lo = 0;
+    size_t hi = set->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (set->items[mid].start <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// SET OPERATIONS
+
+// Starts with no storage; the first add allocates it from the arena
+void range_set_init(range_set *set, arena *storage) {
+    set->items = NULL;
+    set->count = 0;
+    set->capacity = 0;
+    set->storage = storage;
+}
+
+// Drops the items array along with the ranges, since the arena reclaims it
+void range_set_clear(range_set *set) {
+    set->items = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+// Finds the ranges that overlap or touch [start, end), replaces them with their union
+void range_set_add(range_set *set, size_t start, size_t end) {
+    if (start >= end) {
+        return;
+    }
+
+    // First range that could touch the new one: the one before the insertion point may reach start
+    size_t first = count_starting_by(set, start);
+    if (first > 0 && set->items[first - 1].end >= start) {
+        first--;
+    }
+    // One past the last range starting at or before end
+    size_t last = count_starting_by(set, end);
+
+    if (first < last) {
+        if (set->items[first].start < start) {
+            start = set->items[first].start;
+        }
+        if (set->items[last - 1].end > end) {
+            end = set->items[last - 1].end;
+        }
+    } else if (set->count == set->capacity) {
+        // Grow into a larger array from the arena (the old one is reclaimed on reset)
+        size_t capacity = set->capacity ? set->capacity * 2 : RANGE_SET_INITIAL_CAPACITY;
+        range *items = arena_alloc(set->storage, capacity * sizeof(range));
+        if (set->count > 0) {
+            memcpy(items, set->items, set->count * sizeof(range));
+        }
+        set->items = items;
+        set->capacity = capacity;
+    }
+
+    // Collapse items[first, last) into a single slot holding the merged range
+    size_t removed = last - first;
+    size_t new_slots = 1;
+    if (removed != new_slots) {
+        memmove(&set->items[first + new_slots], &set->items[last],
+                (set->count - last) * sizeof(range));
+        set->count = set->count + new_slots - removed;
+    }
+    set->items[first].start = start;
+    set->items[first].end = end;
+}
+
+// Binary searches for the last range starting at or before pos
+const range *range_set_floor(const range_set *set, size_t pos) {
+    size_t n = count_starting_by(set, pos);
+    return n > 0 ? &set->items[n - 1] : NULL;
+}
+
+// Only the floor range can contain pos since the ranges are disjoint
+const range *range_set_containing(const range_set *set, size_t pos) {
+    const range *r = range_set_floor(set, pos);
+    return (r && pos < r->end) ? r : NULL;
+}
+
+// Only the last range starting before end can reach into [start, end)
+bool range_set_overlaps(const range_set *set, size_t start, size_t end) {
+    if (start >= end) {
+        return false;
+    }
+    const range *r = range_set_floor(set, end - 1);
+    return r && r->end > start;
+}
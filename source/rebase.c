@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../libs/rebase.h"
+
+/*
+ * How a command's positions move across a commit
+ */
+typedef enum {
+    SHAPE_POINT, // A single position
+    SHAPE_RANGE, // A range [start, end)
+    SHAPE_DELETE // A range [pos, pos + len)
+} command_shape;
+
+// HELPER FUNCTIONS
+
+// Orders spans by position for qsort
+static int compare_spans(const void *a, const void *b) {
+    const rebase_span *x = a;
+    const rebase_span *y = b;
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+// Returns how the command's positions are transformed
+static command_shape shape_of(command_opcode opcode) {
+    switch (opcode) {
+    case CMD_DEL:
+        return SHAPE_DELETE;
+    case CMD_BOLD:
+    case CMD_ITALIC:
+    case CMD_CODE:
+    case CMD_LINK:
+        return SHAPE_RANGE;
+    default:
+        return SHAPE_POINT;
+    }
+}
+
+// Returns the commit that produced the given version
+static const rebase_commit *commit_for(const rebase_log *log, uint64_t version) {
+    return &log->commits[version % log->capacity];
+}
+
+// Moves a position across one commit. Inserts before it shift it right and deleted bytes before it
+// shift it left; with after_inserts set it also moves past text inserted exactly at the position.
+static size_t map_position(const rebase_commit *c, size_t pos, bool after_inserts) {
+    size_t inserted = 0;
+    size_t deleted = 0;
+    for (size_t i = 0; i < c->inserts; i++) {
+        const rebase_span *s = &c->spans[i];
+        if (s->pos > pos || (s->pos == pos && !after_inserts)) {
+            break;
+        }
+        inserted += s->len;
+    }
+    for (size_t i = c->inserts; i < c->inserts + c->deletes; i++) {
+        const rebase_span *s = &c->spans[i];
+        if (s->pos >= pos) {
+            break;
+        }
+        deleted += (s->pos + s->len < pos) ? s->len : pos - s->pos;
+    }
+    return pos + inserted - deleted;
+}
+
+// Returns the number of characters in [start, end) the commit left in place
+static size_t surviving_length(const rebase_commit *c, size_t start, size_t end) {
+    size_t left = end - start;
+    for (size_t i = c->inserts; i < c->inserts + c->deletes; i++) {
+        const rebase_span *s = &c->spans[i];
+        if (s->pos >= end) {
+            break;
+        }
+        size_t from = (s->pos > start) ? s->pos : start;
+        size_t to = (s->pos + s->len < end) ? s->pos + s->len : end;
+        if (to > from) {
+            left -= to - from;
+        }
+    }
+    return left;
+}
+
+// LOG
+
+// Starts with nothing to rebase across
+void rebase_log_init(rebase_log *log, uint64_t version, size_t capacity) {
+    log->commits = calloc(capacity, sizeof(rebase_commit));
+    log->capacity = capacity;
+    log->origin_version = version;
+    log->last_version = version;
+}
+
+// Keeps inserts and merged, clamped deletes sorted so a position is mapped in one pass over each list
+void rebase_log_record(rebase_log *log, const document *doc) {
+    // A commit that was never recorded breaks the chain, so nothing older can be rebased across it
+    if (log->last_version != doc->version) {
+        log->origin_version = doc->version;
+        log->last_version = doc->version;
+    }
+
+    size_t count = 0;
+    for (const edit *e = doc->pending; e; e = e->next) {
+        count++;
+    }
+    rebase_span *spans = malloc((count ? count : 1) * sizeof(rebase_span));
+    size_t inserts = 0;
+    for (const edit *e = doc->pending; e; e = e->next) {
+        if (e->type == EDIT_INSERT) {
+            spans[inserts++] = (rebase_span){ e->pos, strlen(e->text) };
+        }
+    }
+    size_t deletes = 0;
+    for (const edit *e = doc->pending; e; e = e->next) {
+        if (e->type == EDIT_DELETE && e->pos < doc->length) {
+            size_t len = (e->del_len > doc->length - e->pos) ? doc->length - e->pos : e->del_len;
+            spans[inserts + deletes++] = (rebase_span){ e->pos, len };
+        }
+    }
+    qsort(spans, inserts, sizeof(rebase_span), compare_spans);
+    qsort(spans + inserts, deletes, sizeof(rebase_span), compare_spans);
+
+    // Merge overlapping or touching deletes
+    rebase_span *del = spans + inserts;
+    size_t merged = 0;
+    for (size_t i = 0; i < deletes; i++) {
+        if (merged > 0 && del[i].pos <= del[merged - 1].pos + del[merged - 1].len) {
+            size_t end = del[i].pos + del[i].len;
+            if (end > del[merged - 1].pos + del[merged - 1].len) {
+                del[merged - 1].len = end - del[merged - 1].pos;
+            }
+        } else {
+            del[merged++] = del[i];
+        }
+    }
+
+    log->last_version++;
+    rebase_commit *slot = &log->commits[log->last_version % log->capacity];
+    free(slot->spans);
+    *slot = (rebase_commit){ spans, inserts, merged, doc->length };
+    if (log->last_version - log->origin_version > log->capacity) {
+        log->origin_version = log->last_version - log->capacity;
+    }
+}
+
+// REBASING
+
+// Walks the command's positions forward one commit at a time
+int rebase_command(const rebase_log *log, parsed_command *cmd, uint64_t version, uint64_t current_version) {
+    if (cmd->opcode == CMD_UNKNOWN || version == current_version) {
+        return SUCCESS; // Nothing to move; unknown commands are rejected as usual when executed
+    }
+    if (version < log->origin_version || log->last_version != current_version || version > current_version) {
+        return OUTDATED_VERSION;
+    }
+    command_shape shape = shape_of(cmd->opcode);
+    size_t a = cmd->pos;
+    size_t b = cmd->arg;
+
+    // Positions must have been valid at the command's own version
+    size_t length = commit_for(log, version + 1)->length_before;
+    if (shape == SHAPE_DELETE) {
+        if (a > length || b == 0) {
+            return INVALID_CURSOR_POS;
+        }
+        b = (b > length - a) ? length : a + b; // Deletion end, clamped like the commit clamps it
+    } else if (a > length || (shape == SHAPE_RANGE && (b > length || a > b))) {
+        return INVALID_CURSOR_POS;
+    }
+
+    for (uint64_t v = version + 1; v <= current_version; v++) {
+        const rebase_commit *c = commit_for(log, v);
+        if (shape == SHAPE_POINT) {
+            // A position inside deleted text collapses to where the deletion was
+            a = map_position(c, a, true);
+        } else {
+            // A range is only lost once every character in it is gone; text inserted at its
+            // edges stays outside it
+            if (a < b && surviving_length(c, a, b) == 0) {
+                return DELETED_POSITION;
+            }
+            size_t end = map_position(c, b, false);
+            a = map_position(c, a, true);
+            b = (end > a) ? end : a;
+        }
+    }
+
+    cmd->pos = a;
+    if (shape == SHAPE_DELETE) {
+        // A delete at the very end removes nothing either way, so it keeps its requested length
+        cmd->arg = (b > a) ? b - a : cmd->arg;
+    } else if (shape == SHAPE_RANGE) {
+        cmd->arg = b;
+    }
+    return SUCCESS;
+}
+
+// Frees each commit's spans and the ring itself
+void rebase_log_free(rebase_log *log) {
+    for (size_t i = 0; i < log->capacity; i++) {
+        free(log->commits[i].spans);
+    }
+    free(log->commits);
+    log->commits = NULL;
+}
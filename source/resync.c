@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "../libs/resync.h"
+
+#define FNV64_OFFSET 14695981039346656037ull
+#define FNV64_PRIME 1099511628211ull
+#define WEAK_MASK 0xffffu // Both halves of the weak sum are kept modulo 2^16
+#define OP_LINE_LEN 64 // Longest operation or signature line
+#define NO_BLOCK SIZE_MAX // End of a hash chain
+
+/*
+ * Hash table from weak sums to full-size blocks; blocks sharing a bucket are chained
+ */
+typedef struct {
+    size_t *heads; // First block in each bucket
+    size_t *next; // Next block in the same bucket
+    size_t mask; // Bucket count - 1
+} block_table;
+
+/*
+ * Pending output of resync_diff: a run of consecutive copied blocks is held back so
+ * neighbouring matches merge into one operation
+ */
+typedef struct {
+    FILE *out; // Stream the operations go to
+    size_t run_first; // First block of the pending run
+    size_t run_count; // Blocks in the pending run (0 if none)
+    resync_stats stats; // Totals so far
+} diff_writer;
+
+// HELPER FUNCTIONS
+
+// 64-bit FNV-1a over a block
+static uint64_t strong_hash(const char *data, size_t len) {
+    uint64_t hash = FNV64_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= FNV64_PRIME;
+    }
+    return hash;
+}
+
+// Computes both halves of the weak sum over a block: a is the byte sum, b weights each byte by its distance from the end
+static void weak_parts(const char *data, size_t len, uint32_t *a, uint32_t *b) {
+    uint32_t sa = 0;
+    uint32_t sb = 0;
+    for (size_t i = 0; i < len; i++) {
+        sa += (unsigned char)data[i];
+        sb += (uint32_t)(len - i) * (unsigned char)data[i];
+    }
+    *a = sa;
+    *b = sb;
+}
+
+// Packs the two halves into the value carried in signatures
+static uint32_t weak_combine(uint32_t a, uint32_t b) {
+    return (a & WEAK_MASK) | ((b & WEAK_MASK) << 16);
+}
+
+// Spreads a weak sum over the buckets
+static size_t bucket_of(const block_table *t, uint32_t weak) {
+    return (size_t)((weak * 2654435761u) >> 7) & t->mask;
+}
+
+// Indexes every full-size block of the client's copy by weak sum
+static void table_build(block_table *t, const resync_block *blocks, size_t full_blocks) {
+    size_t buckets = 16;
+    while (buckets < 2 * full_blocks) {
+        buckets *= 2;
+    }
+    t->mask = buckets - 1;
+    t->heads = malloc(buckets * sizeof(size_t));
+    t->next = malloc((full_blocks ? full_blocks : 1) * sizeof(size_t));
+    for (size_t i = 0; i < buckets; i++) {
+        t->heads[i] = NO_BLOCK;
+    }
+    // Insert back to front so each chain lists blocks in document order
+    for (size_t i = full_blocks; i-- > 0; ) {
+        size_t b = bucket_of(t, blocks[i].weak);
+        t->next[i] = t->heads[b];
+        t->heads[b] = i;
+    }
+}
+
+// Finds a block equal to the window at data, preferring the one that extends the pending run.
+// The strong hash is only computed once a weak sum matches.
+static size_t table_find(const block_table *t, const resync_block *blocks, uint32_t weak,
+                         const char *data, size_t block_size, size_t preferred) {
+    bool have_strong = false;
+    uint64_t strong = 0;
+    size_t found = NO_BLOCK;
+    for (size_t i = t->heads[bucket_of(t, weak)]; i != NO_BLOCK; i = t->next[i]) {
+        if (blocks[i].weak != weak) {
+            continue;
+        }
+        if (!have_strong) {
+            strong = strong_hash(data, block_size);
+            have_strong = true;
+        }
+        if (blocks[i].strong == strong) {
+            if (i == preferred) {
+                return i;
+            }
+            if (found == NO_BLOCK) {
+                found = i;
+            }
+        }
+    }
+    return found;
+}
+
+// Writes the pending run of copied blocks, if any
+static void flush_run(diff_writer *w) {
+    if (w->run_count > 0) {
+        fprintf(w->out, "COPY %zu %zu\n", w->run_first, w->run_count);
+        w->run_count = 0;
+    }
+}
+
+// Adds a copied block, extending the pending run when it follows on
+static void emit_copy(diff_writer *w, size_t block, size_t bytes) {
+    if (w->run_count > 0 && w->run_first + w->run_count == block) {
+        w->run_count++;
+    } else {
+        flush_run(w);
+        w->run_first = block;
+        w->run_count = 1;
+    }
+    w->stats.copied += bytes;
+}
+
+// Sends bytes the client does not have
+static void emit_literal(diff_writer *w, const char *data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    flush_run(w);
+    fprintf(w->out, "DATA %zu\n", len);
+    fwrite(data, 1, len, w->out);
+    w->stats.literal += len;
+}
+
+// Reads one line, dropping whatever does not fit in the buffer. Returns false at end of input.
+static bool read_line(FILE *in, char *line, size_t size) {
+    if (!fgets(line, (int)size, in)) {
+        return false;
+    }
+    if (!strchr(line, '\n')) {
+        int ch;
+        while ((ch = getc(in)) != EOF && ch != '\n') {
+        }
+    }
+    return true;
+}
+
+// SIGNATURES
+
+// One line per block, in hex to keep the lines short
+void resync_send_signature(FILE *out, const char *data, size_t len, size_t block_size) {
+    fprintf(out, "RESYNC %zu %zu\n", block_size, len);
+    for (size_t off = 0; off < len; off += block_size) {
+        size_t n = (len - off < block_size) ? len - off : block_size;
+        uint32_t a, b;
+        weak_parts(data + off, n, &a, &b);
+        fprintf(out, "%08" PRIx32 " %016" PRIx64 "\n", weak_combine(a, b), strong_hash(data + off, n));
+    }
+    fflush(out);
+}
+
+// Expects one well-formed line per block, but reads every announced line even once the
+// signature is rejected. The length and block size come from the client, so they are bounded
+// before they size an allocation.
+resync_block *resync_read_signature(FILE *in, size_t len, size_t block_size) {
+    size_t count = len / block_size + (len % block_size != 0);
+    bool acceptable = block_size >= RESYNC_MIN_BLOCK_SIZE && block_size <= RESYNC_MAX_BLOCK_SIZE &&
+                      len <= RESYNC_MAX_BASIS_LEN;
+    resync_block *blocks = acceptable ? malloc((count ? count : 1) * sizeof(resync_block)) : NULL;
+    char line[OP_LINE_LEN];
+    for (size_t i = 0; i < count; i++) {
+        if (!read_line(in, line, sizeof(line))) {
+            free(blocks);
+            return NULL;
+        }
+        if (blocks && sscanf(line, "%" SCNx32 " %" SCNx64, &blocks[i].weak, &blocks[i].strong) != 2) {
+            free(blocks);
+            blocks = NULL;
+        }
+    }
+    return blocks;
+}
+
+// DIFF AND APPLY
+
+// Slides a block-sized window over data one byte at a time, rolling the weak sum in O(1) per step.
+// On a match the window jumps a whole block; a short last block can only match at the very end.
+void resync_diff(const char *data, size_t len, const resync_block *blocks, size_t basis_len,
+                 size_t block_size, FILE *out, resync_stats *stats) {
+    size_t count = (basis_len + block_size - 1) / block_size;
+    size_t tail_len = basis_len % block_size;
+    size_t full_blocks = tail_len ? count - 1 : count;
+
+    block_table table;
+    table_build(&table, blocks, full_blocks);
+    diff_writer w = { out, 0, 0, { 0, 0 } };
+
+    size_t pos = 0;
+    size_t literal_start = 0;
+    bool have_sum = false;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    while (full_blocks > 0 && pos + block_size <= len) {
+        if (!have_sum) {
+            weak_parts(data + pos, block_size, &a, &b);
+            have_sum = true;
+        }
+        size_t preferred = (w.run_count > 0) ? w.run_first + w.run_count : NO_BLOCK;
+        size_t match = table_find(&table, blocks, weak_combine(a, b), data + pos, block_size, preferred);
+        if (match != NO_BLOCK) {
+            emit_literal(&w, data + literal_start, pos - literal_start);
+            emit_copy(&w, match, block_size);
+            pos += block_size;
+            literal_start = pos;
+            have_sum = false;
+            continue;
+        }
+        if (pos + block_size < len) {
+            uint32_t leaving = (unsigned char)data[pos];
+            a = a - leaving + (unsigned char)data[pos + block_size];
+            b = b - (uint32_t)block_size * leaving + a;
+        }
+        pos++;
+    }
+
+    // The client's short last block, if it is still the end of the document
+    if (tail_len > 0 && len - literal_start >= tail_len) {
+        const char *tail = data + len - tail_len;
+        uint32_t ta, tb;
+        weak_parts(tail, tail_len, &ta, &tb);
+        if (weak_combine(ta, tb) == blocks[count - 1].weak && strong_hash(tail, tail_len) == blocks[count - 1].strong) {
+            emit_literal(&w, data + literal_start, (size_t)(tail - (data + literal_start)));
+            emit_copy(&w, count - 1, tail_len);
+            literal_start = len;
+        }
+    }
+    emit_literal(&w, data + literal_start, len - literal_start);
+    flush_run(&w);
+    fputs(RESYNC_END_LINE, out);
+
+    free(table.heads);
+    free(table.next);
+    if (stats) {
+        *stats = w.stats;
+    }
+}
+
+// Every operation is bounds-checked against the basis and the announced length. After a bad
+// operation the rest of the reply is still read (skipping the bytes of each DATA), so none of it
+// is left in the stream.
+char *resync_apply(FILE *in, const char *basis, size_t basis_len, size_t block_size,
+                   size_t length, resync_stats *stats) {
+    char *text = malloc(length + 1);
+    resync_stats totals = { 0, 0 };
+    size_t written = 0;
+    char line[OP_LINE_LEN];
+    bool ok = (text != NULL);
+    bool ended = false;
+    while (read_line(in, line, sizeof(line))) {
+        size_t first, n;
+        if (strcmp(line, RESYNC_END_LINE) == 0) {
+            ended = true;
+            break;
+        } else if (sscanf(line, "COPY %zu %zu", &first, &n) == 2) {
+            if (!ok || first > basis_len / block_size || n > (basis_len - first * block_size) / block_size + 1) {
+                ok = false;
+                continue;
+            }
+            size_t start = first * block_size;
+            size_t end = (n * block_size > basis_len - start) ? basis_len : start + n * block_size;
+            if (end - start > length - written) {
+                ok = false;
+                continue;
+            }
+            memcpy(text + written, basis + start, end - start);
+            written += end - start;
+            totals.copied += end - start;
+        } else if (sscanf(line, "DATA %zu", &n) == 1) {
+            if (!ok || n > length - written) {
+                ok = false;
+                while (n > 0 && getc(in) != EOF) {
+                    n--;
+                }
+                continue;
+            }
+            if (fread(text + written, 1, n, in) != n) {
+                break;
+            }
+            written += n;
+            totals.literal += n;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok || !ended || written != length) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    if (stats) {
+        *stats = totals;
+    }
+    return text;
+}
@@ -0,0 +1,321 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../libs/scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#define SAD_FLUSH_INTERVAL 255 // Byte counters overflow after 255 vector iterations
+#define ASCII_PRINT_MIN 32
+#define ASCII_PRINT_MAX 126
+
+// SCALAR KERNELS (portable fallback, also used for the tails of the vector kernels)
+
+// memchr is the portable fallback; the x86 levels inline their own search instead of a call
+static const char *find_newline_scalar(const char *data, size_t len) {
+    return memchr(data, '\n', len);
+}
+
+static const char *find_last_newline_scalar(const char *data, size_t len) {
+    while (len > 0) {
+        if (data[--len] == '\n') {
+            return data + len;
+        }
+    }
+    return NULL;
+}
+
+static size_t count_newlines_scalar(const char *data, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        count += (data[i] == '\n');
+    }
+    return count;
+}
+
+static const char *find_list_prefix_scalar(const char *data, size_t len) {
+    for (size_t i = 0; i + 2 < len; i++) {
+        if (data[i] >= '0' && data[i] <= '9' && data[i + 1] == '.' && data[i + 2] == ' ') {
+            return data + i;
+        }
+    }
+    return NULL;
+}
+
+static size_t find_non_printable_scalar(const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c < ASCII_PRINT_MIN || c > ASCII_PRINT_MAX) {
+            return i;
+        }
+    }
+    return len;
+}
+
+static const scan_kernels scalar_kernels = {
+    SCAN_SCALAR, "scalar",
+    find_newline_scalar, find_last_newline_scalar, count_newlines_scalar,
+    find_list_prefix_scalar, find_non_printable_scalar
+};
+
+#ifdef SCAN_X86
+
+// SSE2 KERNELS (16 bytes per step)
+
+// Four vectors are compared per step and their matches OR-ed, so a long line costs one branch
+// per 64 bytes; the exact byte is located only in the step that found one
+static const char *find_newline_sse2(const char *data, size_t len) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m128i m0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), nl);
+        __m128i m1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 16)), nl);
+        __m128i m2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 32)), nl);
+        __m128i m3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 48)), nl);
+        __m128i any = _mm_or_si128(_mm_or_si128(m0, m1), _mm_or_si128(m2, m3));
+        if (_mm_movemask_epi8(any)) {
+            uint64_t mask = (uint64_t)(unsigned)_mm_movemask_epi8(m0) |
+                            (uint64_t)(unsigned)_mm_movemask_epi8(m1) << 16 |
+                            (uint64_t)(unsigned)_mm_movemask_epi8(m2) << 32 |
+                            (uint64_t)(unsigned)_mm_movemask_epi8(m3) << 48;
+            return data + i + __builtin_ctzll(mask);
+        }
+    }
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        if (mask) {
+            return data + i + __builtin_ctz(mask);
+        }
+    }
+    return find_newline_scalar(data + i, len - i);
+}
+
+static const char *find_last_newline_sse2(const char *data, size_t len) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t end = len;
+    while (end >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + end - 16));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        if (mask) {
+            return data + end - 16 + (31 - __builtin_clz(mask));
+        }
+        end -= 16;
+    }
+    return find_last_newline_scalar(data, end);
+}
+
+// Matches are accumulated in per-byte counters and summed with SAD before they can overflow
+static size_t count_newlines_sse2(const char *data, size_t len) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 16 <= len) {
+        __m128i acc = zero;
+        for (int n = 0; n < SAD_FLUSH_INTERVAL && i + 16 <= len; n++, i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, nl));
+        }
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+    return count + count_newlines_scalar(data + i, len - i);
+}
+
+static const char *find_list_prefix_sse2(const char *data, size_t len) {
+    // Bias by 0x80 so the unsigned digit range can be tested with signed compares
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i below_zero = _mm_set1_epi8((char)(('0' - 1) ^ 0x80));
+    const __m128i above_nine = _mm_set1_epi8((char)(('9' + 1) ^ 0x80));
+    const __m128i dot = _mm_set1_epi8('.');
+    const __m128i space = _mm_set1_epi8(' ');
+    size_t i = 0;
+    for (; i + 18 <= len; i += 16) {
+        __m128i v0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + i)), bias);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(data + i + 1));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(data + i + 2));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v0, below_zero), _mm_cmplt_epi8(v0, above_nine));
+        __m128i hit = _mm_and_si128(digit, _mm_and_si128(_mm_cmpeq_epi8(v1, dot), _mm_cmpeq_epi8(v2, space)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask) {
+            return data + i + __builtin_ctz(mask);
+        }
+    }
+    return find_list_prefix_scalar(data + i, len - i);
+}
+
+static size_t find_non_printable_sse2(const char *data, size_t len) {
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i low = _mm_set1_epi8((char)(ASCII_PRINT_MIN ^ 0x80));
+    const __m128i high = _mm_set1_epi8((char)(ASCII_PRINT_MAX ^ 0x80));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + i)), bias);
+        __m128i bad = _mm_or_si128(_mm_cmplt_epi8(v, low), _mm_cmpgt_epi8(v, high));
+        unsigned mask = (unsigned)_mm_movemask_epi8(bad);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + find_non_printable_scalar(data + i, len - i);
+}
+
+static const scan_kernels sse2_kernels = {
+    SCAN_SSE2, "sse2",
+    find_newline_sse2, find_last_newline_sse2, count_newlines_sse2,
+    find_list_prefix_sse2, find_non_printable_sse2
+};
+
+// AVX2 KERNELS (32 bytes per step, compiled for AVX2 regardless of the global flags; tails fall back to SSE2)
+
+#define AVX2 __attribute__((target("avx2")))
+
+// Same unrolling as the SSE2 kernel, 128 bytes per step
+AVX2 static const char *find_newline_avx2(const char *data, size_t len) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 128 <= len; i += 128) {
+        __m256i m0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i)), nl);
+        __m256i m1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 32)), nl);
+        __m256i m2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 64)), nl);
+        __m256i m3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 96)), nl);
+        __m256i any = _mm256_or_si256(_mm256_or_si256(m0, m1), _mm256_or_si256(m2, m3));
+        if (_mm256_movemask_epi8(any)) {
+            uint64_t low = (uint64_t)(unsigned)_mm256_movemask_epi8(m0) |
+                           (uint64_t)(unsigned)_mm256_movemask_epi8(m1) << 32;
+            uint64_t high = (uint64_t)(unsigned)_mm256_movemask_epi8(m2) |
+                            (uint64_t)(unsigned)_mm256_movemask_epi8(m3) << 32;
+            _mm256_zeroupper();
+            return data + i + (low ? __builtin_ctzll(low) : 64 + __builtin_ctzll(high));
+        }
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        if (mask) {
+            _mm256_zeroupper();
+            return data + i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper(); // Avoid the AVX-to-SSE transition penalty in the tail
+    return find_newline_sse2(data + i, len - i);
+}
+
+AVX2 static const char *find_last_newline_avx2(const char *data, size_t len) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t end = len;
+    while (end >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + end - 32));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        if (mask) {
+            return data + end - 32 + (31 - __builtin_clz(mask));
+        }
+        end -= 32;
+    }
+    _mm256_zeroupper(); // Avoid the AVX-to-SSE transition penalty in the tail
+    return find_last_newline_sse2(data, end);
+}
+
+AVX2 static size_t count_newlines_avx2(const char *data, size_t len) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 32 <= len) {
+        __m256i acc = zero;
+        for (int n = 0; n < SAD_FLUSH_INTERVAL && i + 32 <= len; n++, i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, nl));
+        }
+        __m256i sums = _mm256_sad_epu8(acc, zero);
+        count += (size_t)_mm256_extract_epi64(sums, 0) + (size_t)_mm256_extract_epi64(sums, 1) +
+                 (size_t)_mm256_extract_epi64(sums, 2) + (size_t)_mm256_extract_epi64(sums, 3);
+    }
+    _mm256_zeroupper(); // Avoid the AVX-to-SSE transition penalty in the tail
+    return count + count_newlines_sse2(data + i, len - i);
+}
+
+AVX2 static const char *find_list_prefix_avx2(const char *data, size_t len) {
+    const __m256i bias = _mm256_set1_epi8((char)0x80);
+    const __m256i below_zero = _mm256_set1_epi8((char)(('0' - 1) ^ 0x80));
+    const __m256i above_nine = _mm256_set1_epi8((char)(('9' + 1) ^ 0x80));
+    const __m256i dot = _mm256_set1_epi8('.');
+    const __m256i space = _mm256_set1_epi8(' ');
+    size_t i = 0;
+    for (; i + 34 <= len; i += 32) {
+        __m256i v0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(data + i)), bias);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *)(data + i + 2));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v0, below_zero), _mm256_cmpgt_epi8(above_nine, v0));
+        __m256i hit = _mm256_and_si256(digit, _mm256_and_si256(_mm256_cmpeq_epi8(v1, dot), _mm256_cmpeq_epi8(v2, space)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask) {
+            return data + i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper(); // Avoid the AVX-to-SSE transition penalty in the tail
+    return find_list_prefix_sse2(data + i, len - i);
+}
+
+AVX2 static size_t find_non_printable_avx2(const char *data, size_t len) {
+    const __m256i bias = _mm256_set1_epi8((char)0x80);
+    const __m256i low = _mm256_set1_epi8((char)(ASCII_PRINT_MIN ^ 0x80));
+    const __m256i high = _mm256_set1_epi8((char)(ASCII_PRINT_MAX ^ 0x80));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(data + i)), bias);
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi8(low, v), _mm256_cmpgt_epi8(v, high));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(bad);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper(); // Avoid the AVX-to-SSE transition penalty in the tail
+    return i + find_non_printable_sse2(data + i, len - i);
+}
+
+static const scan_kernels avx2_kernels = {
+    SCAN_AVX2, "avx2",
+    find_newline_avx2, find_last_newline_avx2, count_newlines_avx2,
+    find_list_prefix_avx2, find_non_printable_avx2
+};
+
+#endif // SCAN_X86
+
+// DISPATCH
+
+const scan_kernels *scan = &scalar_kernels;
+
+// Hands out a kernel table only if the running CPU can execute it
+const scan_kernels *scan_get_kernels(scan_level level) {
+    switch (level) {
+    case SCAN_SCALAR:
+        return &scalar_kernels;
+#ifdef SCAN_X86
+    case SCAN_SSE2:
+        return __builtin_cpu_supports("sse2") ? &sse2_kernels : NULL;
+    case SCAN_AVX2:
+        return __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+// Picks the best supported kernels once, before main() runs
+__attribute__((constructor)) static void scan_select_kernels(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+#endif
+    for (int level = SCAN_AVX2; level >= SCAN_SCALAR; level--) {
+        const scan_kernels *k = scan_get_kernels((scan_level)level);
+        if (k) {
+            scan = k;
+            return;
+        }
+    }
+}
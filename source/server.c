@@ -10,19 +10,45 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
 
 #include "../libs/server.h"
 #include "../libs/markdown.h"
 #include "../libs/command_queue.h"
 #include "../libs/helper.h"
+#include "../libs/compact.h"
+#include "../libs/snapshot.h"
+#include "../libs/journal.h"
+#include "../libs/checkpoint.h"
+#include "../libs/history.h"
+#include "../libs/resync.h"
+#include "../libs/chunk_tree.h"
+#include "../libs/ops.h"
+#include "../libs/rebase.h"
+#include "../libs/frame.h"
+#include "../libs/scan.h"
+#include "../libs/arena.h"
+#include "../libs/range_set.h"
 
 #define USERNAME_LEN 128
+#define BASE_DECIMAL 10
 
 // Server state and document versioning
-version_log *log_head = NULL;
-int current_version = 0;
-queued_command *cmd_queue = NULL;
+version_history history; // Broadcast blocks by version, older segments spilled to disk
+uint64_t current_version = 0;
+command_inbox cmd_inbox; // Each client's commands, pushed without taking doc_lock
 document *doc = NULL;
+snapshot_store snapshots; // Committed versions for readers that do not take doc_lock
+journal wal; // Write-ahead journal of successful commands
+uint64_t checkpoint_version = 0; // Version captured by the latest checkpoint (or the one being written)
+pthread_t checkpoint_tid; // Thread writing a checkpoint in the background
+bool checkpoint_running = false; // checkpoint_tid has been started and not yet joined (guarded by doc_lock)
+atomic_bool checkpoint_finished; // Set by the checkpoint thread as it exits
+bool rebase_stale = false; // Rebase commands from older versions instead of rejecting them (--rebase)
+rebase_log rebase; // Primitives of recent commits, for rebasing stale commands
+bool group_commit = false; // Commit each tick's commands as a single version (--group-commit)
+tick_index tick_edits; // Edits accepted so far in the current tick (--group-commit)
 
 // Thread-safety for shared data
 pthread_mutex_t client_count_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -32,6 +58,7 @@ pthread_mutex_t client_list_lock = PTHREAD_MUTEX_INITIALIZER;
 // Track number of connected clients and their output pipes
 int client_count = 0;
 client_pipe *client_list = NULL;
+uint32_t next_user_id = 1; // Id for the next client to register (0 marks the server's own frames; guarded by client_list_lock)
 
 /*
  *Read roles.txt to verify a user's role(i.e. "read" or "write")
@@ -60,122 +87,359 @@ bool check_user_role(const char *username, char *out_role) {
 }
 
 /*
- *Frees all allocated memory for logs when server shuts down
+ * Formats the log line of a command's outcome, "EDIT <user> <command> <result>".
+ * Returns a string the caller frees; it is never cut short, however long the command.
  */
-void free_logs() {
-    version_log *vlog = log_head;
-    while (vlog) {
-        log_entry *e = vlog->entries;
-        while (e) {
-            log_entry *tmp = e;
-            e = e->next;
-            free(tmp->line);
-            free(tmp);
+char *format_edit_line(const char *username, const char *command, int result) {
+    const char *outcome;
+    if (result == SUCCESS) {
+        outcome = "SUCCESS";
+    } else if (result == UNAUTHORISED_ROLE) {
+        outcome = "Reject UNAUTHORISED";
+    } else if (result == INVALID_CURSOR_POS) {
+        outcome = "Reject INVALID_POSITION";
+    } else if (result == DELETED_POSITION) {
+        outcome = "Reject DELETED_POSITION";
+    } else if (result == OUTDATED_VERSION) {
+        outcome = "Reject OUTDATED_VERSION";
+    } else if (result == CONFLICTING_EDIT) {
+        outcome = "Reject CONFLICTING_EDIT";
+    } else {
+        outcome = "Reject UNKNOWN_COMMAND";
+    }
+    size_t size = strlen(username) + strlen(command) + strlen(outcome) + sizeof("EDIT   ");
+    char *line = malloc(size);
+    snprintf(line, size, "EDIT %s %s %s", username, command, outcome);
+    return line;
+}
+
+/*
+ * Returns the end of a pending delete, clamped so a huge length cannot wrap around
+ */
+size_t delete_end(const edit *e) {
+    return (e->del_len > SIZE_MAX - e->pos) ? SIZE_MAX : e->pos + e->del_len;
+}
+
+/*
+ * Starts a tick with no edits, releasing the ranges of the last one without visiting them
+ */
+void tick_index_reset(tick_index *index) {
+    arena_reset(&index->storage);
+    range_set_clear(&index->inserts);
+    range_set_clear(&index->deletes);
+    range_set_clear(&index->interiors);
+}
+
+/*
+ * Returns whether an edit queued from first onwards touches the same text as one accepted earlier
+ * in the tick: deletions sharing a byte, an insertion strictly inside a deletion, or two insertions
+ * at the same position. Under --group-commit every command of a tick is resolved against the same
+ * committed text, so a command cannot see what earlier ones in the tick are about to change there.
+ */
+bool conflicts_with_tick(const tick_index *index, const edit *first) {
+    for (const edit *e = first; e; e = e->next) {
+        if (e->type == EDIT_INSERT) {
+            if (range_set_containing(&index->inserts, e->pos) || range_set_containing(&index->interiors, e->pos)) {
+                return true;
+            }
+        } else {
+            size_t end = delete_end(e);
+            if (range_set_overlaps(&index->deletes, e->pos, end) ||
+                (e->pos < SIZE_MAX && range_set_overlaps(&index->inserts, e->pos + 1, end))) {
+                return true;
+            }
         }
-        version_log *tmpv = vlog;
-        vlog = vlog->next;
-        free(tmpv);
     }
+    return false;
+}
+
+/*
+ * Adds the edits of an accepted command, queued from first onwards, to the tick's index
+ */
+void tick_index_add(tick_index *index, const edit *first) {
+    for (const edit *e = first; e; e = e->next) {
+        if (e->type == EDIT_INSERT) {
+            range_set_add(&index->inserts, e->pos, e->pos + 1);
+        } else if (e->pos < SIZE_MAX) {
+            size_t end = delete_end(e);
+            range_set_add(&index->deletes, e->pos, end);
+            range_set_add(&index->interiors, e->pos + 1, end);
+        }
+    }
+}
+
+/*
+ * Writes a pinned snapshot as the new checkpoint without holding any lock, then deletes the
+ * retired journal segment, whose records the checkpoint now covers.
+ */
+void *checkpoint_thread(void *arg) {
+    snapshot *snap = arg;
+    if (checkpoint_write(snap, CHECKPOINT_PATH) == 0 && unlink(JOURNAL_RETIRED_PATH) != 0 && errno != ENOENT) {
+        perror("remove retired journal");
+    }
+    snapshot_release(snap);
+    atomic_store(&checkpoint_finished, true);
+    return NULL;
+}
+
+/*
+ * Starts a checkpoint of the current snapshot in the background. Called by the broadcast
+ * thread with doc_lock held, right after publishing and flushing, so the journal holds exactly
+ * the records up to the snapshot's version. Those are rotated into the retired segment and later
+ * records go to a fresh file. If an earlier checkpoint failed, its retired segment is still
+ * there and is kept; the current file then simply carries some records replay will skip.
+ */
+void start_checkpoint(void) {
+    snapshot *snap = snapshot_pin(&snapshots);
+    if (access(JOURNAL_RETIRED_PATH, F_OK) != 0) {
+        journal_rotate(&wal, JOURNAL_PATH, JOURNAL_RETIRED_PATH);
+    }
+    checkpoint_version = snap->version;
+    atomic_store(&checkpoint_finished, false);
+    if (pthread_create(&checkpoint_tid, NULL, checkpoint_thread, snap) != 0) {
+        perror("pthread_create checkpoint_thread");
+        snapshot_release(snap);
+        return;
+    }
+    checkpoint_running = true;
+}
+
+/*
+ * Waits for a background checkpoint to finish (doc_lock held)
+ */
+void join_checkpoint(void) {
+    if (checkpoint_running) {
+        pthread_join(checkpoint_tid, NULL);
+        checkpoint_running = false;
+    }
+}
+
+/*
+ * Writes the current snapshot as the new checkpoint and, once it is durable, empties the
+ * journal it supersedes. Used at shutdown, with doc_lock held and nothing left to journal.
+ */
+void write_checkpoint(void) {
+    join_checkpoint();
+    snapshot *snap = snapshot_pin(&snapshots);
+    if (checkpoint_write(snap, CHECKPOINT_PATH) == 0) {
+        // A journal left behind only costs replay time: its records are all covered by the checkpoint
+        if (journal_truncate(&wal) != 0 || (unlink(JOURNAL_RETIRED_PATH) != 0 && errno != ENOENT)) {
+            fprintf(stderr, "Checkpoint at version %llu written, but the journal could not be emptied\n",
+                    (unsigned long long)snap->version);
+        }
+        checkpoint_version = snap->version;
+    }
+    snapshot_release(snap);
 }
 
 /*
  * Broadcast thread function that runs every TIME_INTERVAL. 
  * - Locks the document and processes all queued commands in order of arrival. 
  * - Increments document version for successful edits.
- * - Broadcasts the results of all commands (success or reject) to all clients. 
+ * - With --rebase, moves commands issued against an older version forward across the
+ *   commits made since, instead of rejecting them as outdated.
+ * - With --group-commit, validates every command against the tick's base version and
+ *   commits all of them together, so the tick is broadcast as a single version.
+ * - Broadcasts the results of all commands (success or reject) to all clients, as text lines or,
+ *   to clients that negotiated binary framing, as one block of frames encoded once per tick.
  * This ensures synchronisation across all clients and avoids race conditions resulting from concurrent edits.
  */
 void *broadcast_thread(void *arg) {
     int interval = *((int *)arg); // Interval in ms between broadcasts
+    byte_buffer frames = { NULL, 0, 0 }; // Each tick's block for binary clients, encoded once for all of them
+    log_entry *entry_head = NULL; // Each tick's block for text clients
+    log_entry **entry_tail = &entry_head;
+    bool held = false; // The last block is waiting for its journal records to become durable
 
     while (1) {
         usleep(interval * 1000);
         // Lock document while processing updates
         pthread_mutex_lock(&doc_lock);
 
-        // Prepare log entry list for this broadcast
-        log_entry *entry_head = NULL;
-        log_entry **entry_tail = &entry_head;
+        // Prepare log entry list for this broadcast, unless the last one still has to go out
+        if (!held) {
+            entry_head = NULL;
+            entry_tail = &entry_head;
+            frames.len = 0;
+        }
+
+        // Take every command queued since the last tick in one batch, merged from the
+        // clients' queues in timestamp order. While a block is held no edits are accepted:
+        // they stay queued until the journal can be written again.
+        queued_command *batch = held ? NULL : command_inbox_drain(&cmd_inbox);
 
         // Process all queued commands
-        if (cmd_queue != NULL) {
-            // Ensure commands are ordered by timestamp
-            sort_command_queue(&cmd_queue); 
-
+        if (batch != NULL) {
             // Process each command in the queue
-            while (cmd_queue) {
-                char *username = cmd_queue->username;
-                char *role = cmd_queue->role;
-                char *command = cmd_queue->command_str;
-                uint64_t version = cmd_queue->client_version;
-                char log_line[LINE_LEN];
+            while (batch) {
+                char *username = batch->username;
+                char *role = batch->role;
+                char *command = batch->command_str;
+                uint64_t version = batch->client_version;
+                char *rebased = NULL; // The command with its positions moved forward, if it was rebased
+                char *paste_header = NULL; // "PASTE <pos> <len>": a paste's text only travels as primitives
+                char *ops = NULL; // Resolved primitives of a successful command
+                edit *mark = doc->pending_tail; // Edits queued by earlier commands of this tick
+                int result = SUCCESS;
+                if (batch->op.opcode == CMD_PASTE) {
+                    paste_header = malloc(LINE_LEN);
+                    command_format(command, &batch->op, paste_header, LINE_LEN);
+                }
+                const char *logged = paste_header ? paste_header : command;
 
                 // Reject edit if user has read-only permissions
                 if (strcmp(role, "read") == 0) {
-                    snprintf(log_line, sizeof(log_line), "EDIT %s %s Reject UNAUTHORISED", username, command);
+                    result = UNAUTHORISED_ROLE;
                 } else {
-                    // Process the command and determine outcome
-                    int result = process_command(doc, command, version);
-
+                    // Process the command and determine outcome, first moving a stale command's
+                    // positions forward to the current version if rebasing is enabled
+                    parsed_command op = batch->op; // Parsed by the client thread, so the tick only executes it
+                    if (rebase_stale && version != doc->version) {
+                        result = rebase_command(&rebase, &op, version, doc->version);
+                        if (result == SUCCESS) {
+                            // Positions grow by at most a few digits, so LINE_LEN spare bytes always fit
+                            size_t rebased_size = strlen(command) + LINE_LEN;
+                            rebased = malloc(rebased_size);
+                            command_format(command, &op, rebased, rebased_size);
+                        }
+                        version = doc->version;
+                    }
                     if (result == SUCCESS) {
-                        markdown_increment_version(doc); // Commit the changes
-                        current_version = doc->version;
-                        snprintf(log_line, sizeof(log_line), "EDIT %s %s SUCCESS", username, command);
-                    } else if (result == INVALID_CURSOR_POS) {
-                        snprintf(log_line, sizeof(log_line), "EDIT %s %s Reject INVALID_POSITION", username, command);
-                    } else if (result == DELETED_POSITION) {
-                        snprintf(log_line, sizeof(log_line), "EDIT %s %s Reject DELETED_POSITION", username, command);
-                    } else if (result == OUTDATED_VERSION) {
-                        snprintf(log_line, sizeof(log_line), "EDIT %s %s Reject OUTDATED_VERSION", username, command);
+                        result = command_execute(doc, command, &op, version);
+                    }
+                    const edit *queued = mark ? mark->next : doc->pending;
+                    if (result == SUCCESS && group_commit) {
+                        if (conflicts_with_tick(&tick_edits, queued)) {
+                            result = CONFLICTING_EDIT;
+                        } else {
+                            tick_index_add(&tick_edits, queued);
+                        }
+                    }
+                    if (result != SUCCESS) {
+                        // Drop anything a command rejected part way through had already queued
+                        markdown_discard_pending(doc, mark);
                     }
                 }
-                // Build the log entry for this command
+
+                // Log the outcome, in the text log and in the binary block
                 log_entry *entry = malloc(sizeof(log_entry));
-                entry->line = strdup(log_line);
+                entry->line = format_edit_line(username, logged, result);
                 entry->next = NULL;
                 *entry_tail = entry;
                 entry_tail = &entry->next;
+                frame_append(&frames, FRAME_EDIT, batch->user_id, 0, entry->line, strlen(entry->line));
+
+                if (result == SUCCESS) {
+                    // Capture the primitives the command resolved to before the commit consumes them
+                    const edit *first = mark ? mark->next : doc->pending;
+                    ops = ops_format(first, !group_commit);
+                    frame_append_edits(&frames, batch->user_id, first, !group_commit);
+                    const char *applied = rebased ? rebased : logged;
+                    if (group_commit) {
+                        // Left pending until the end of the tick; the journal entry commits with it
+                        journal_append(&wal, doc->version + 1, username, applied, ops);
+                    } else {
+                        if (rebase_stale) {
+                            rebase_log_record(&rebase, doc);
+                        }
+                        markdown_increment_version(doc); // Commit the changes
+                        current_version = doc->version;
+                        journal_append(&wal, doc->version, username, applied, ops);
+                    }
+
+                    // Follow a success with its primitives so clients replay them instead of the command
+                    log_entry *ops_entry = malloc(sizeof(log_entry));
+                    ops_entry->line = ops;
+                    ops_entry->next = NULL;
+                    *entry_tail = ops_entry;
+                    entry_tail = &ops_entry->next;
+                }
 
                 // Free the processed command
-                queued_command *old = cmd_queue;
-                cmd_queue = cmd_queue->next;
+                queued_command *old = batch;
+                batch = batch->next;
+                free(rebased);
+                free(paste_header);
                 free(username);
                 free(role);
                 free(command);
                 free(old);
             }
         }
+        // In group-commit mode the whole tick becomes one version, committed after its last command
+        if (group_commit && doc->pending) {
+            if (rebase_stale) {
+                rebase_log_record(&rebase, doc);
+            }
+            markdown_increment_version(doc);
+            current_version = doc->version;
+            tick_index_reset(&tick_edits);
+            journal_append(&wal, doc->version, "", "", OPS_COMMIT_LINE);
+            frame_append(&frames, FRAME_COMMIT, 0, 0, NULL, 0);
+
+            log_entry *commit_entry = malloc(sizeof(log_entry));
+            commit_entry->line = strdup(OPS_COMMIT_LINE);
+            commit_entry->next = NULL;
+            *entry_tail = commit_entry;
+            entry_tail = &commit_entry->next;
+        }
+
+        // Make this tick's edits durable before any client hears about them. If that fails the
+        // block is neither published nor broadcast; the next tick retries the same records.
+        held = (journal_flush(&wal) != 0);
+        if (held) {
+            pthread_mutex_unlock(&doc_lock);
+            continue;
+        }
+
         // Determine broadcast version after processing all commands
-        int broadcast_version = doc->version;
+        uint64_t broadcast_version = doc->version;
 
         // Build version_log for this broadcast
         version_log *new_log = malloc(sizeof(version_log));
         new_log->version_number = broadcast_version;
+        new_log->doc_hash = chunk_tree_hash(doc); // Lets clients check their replayed copy
         new_log->entries = entry_head;
-        new_log->next = NULL;
 
-        // Send the updates to all currently connected clients
+        // Publish the new version and send the updates to all currently connected clients.
+        // Both happen under client_list_lock, so a client registering in between sees a
+        // snapshot that matches the first broadcast it receives.
         pthread_mutex_lock(&client_list_lock);
+        if (snapshot_current_version(&snapshots) != doc->version) {
+            snapshot_publish(&snapshots, doc);
+        } else {
+            snapshot_reclaim(&snapshots, doc);
+        }
         client_pipe *curr = client_list;
         while (curr) {
-            dprintf(curr->fd, "VERSION %d\n", broadcast_version);
-            log_entry *e = new_log->entries;
-            while (e) {
-                dprintf(curr->fd, "%s\n", e->line);
-                e = e->next;
+            pthread_mutex_lock(&curr->write_lock);
+            if (curr->binary) {
+                frame_write_block(curr->fd, broadcast_version, new_log->doc_hash, &frames);
+            } else {
+                dprintf(curr->fd, "VERSION %llu %016llx\n", (unsigned long long)broadcast_version, (unsigned long long)new_log->doc_hash);
+                log_entry *e = new_log->entries;
+                while (e) {
+                    dprintf(curr->fd, "%s\n", e->line);
+                    e = e->next;
+                }
+                dprintf(curr->fd, "END\n");
             }
-            dprintf(curr->fd, "END\n");
+            pthread_mutex_unlock(&curr->write_lock);
             curr = curr->next;
         }
+
+        // Save the log in the server's version history. This happens under the same lock as the
+        // fan-out, so a client registering later finds the block in the history instead.
+        history_append(&history, new_log);
         pthread_mutex_unlock(&client_list_lock);
 
-        // Save the log in the server's version history
-        if (!log_head) {
-            log_head = new_log;
-        } else {
-            version_log *tail_log = log_head;
-            while (tail_log->next) tail_log = tail_log->next;
-            tail_log->next = new_log;
+        // Periodically fold the journal into a checkpoint so restarts only replay a short tail.
+        // The image is written by its own thread, so ticks carry on while it is being synced.
+        if (checkpoint_running && atomic_load(&checkpoint_finished)) {
+            join_checkpoint();
+        }
+        if (!checkpoint_running && doc->version - checkpoint_version >= CHECKPOINT_EVERY_VERSIONS) {
+            start_checkpoint();
         }
         // Unlock document after processing
         pthread_mutex_unlock(&doc_lock);
@@ -184,6 +448,186 @@ void *broadcast_thread(void *arg) {
     return NULL;
 }
 
+/*
+ * Answers a client's RESYNC request with only the parts of the current version its copy lacks.
+ * Reads the block signature that follows the request line (all of it, even when the request is
+ * rejected), then works the reply out from a pinned snapshot without holding any lock. Only
+ * writing it takes the client's write lock, after client_list_lock has shown that every
+ * broadcast up to the current version (at least the snapshot's) is already ahead in the FIFO.
+ * Later ones queue behind the reply; the client replays the newer blocks that came first.
+ * Returns false if the request line is so malformed that the number of signature lines after
+ * it is unknown; the client's later lines cannot be told apart from them, so it is dropped.
+ */
+bool send_resync(FILE *c2s, client_pipe *client, const char *request) {
+    size_t block_size;
+    size_t basis_len;
+    resync_block *blocks = NULL;
+    bool readable = (sscanf(request, "RESYNC %zu %zu", &block_size, &basis_len) == 2 && block_size > 0);
+    if (readable) {
+        blocks = resync_read_signature(c2s, basis_len, block_size);
+    }
+
+    snapshot *snap = snapshot_pin(&snapshots);
+    char *reply = NULL;
+    size_t reply_len = 0;
+    FILE *out = open_memstream(&reply, &reply_len);
+    if (out) {
+        if (blocks) {
+            char *text = snapshot_flatten(snap);
+            fprintf(out, "RESYNC %llu %zu\n", (unsigned long long)snap->version, snap->length);
+            resync_diff(text, snap->length, blocks, basis_len, block_size, out, NULL);
+            free(text);
+        } else {
+            fprintf(out, "RESYNC_REJECTED\n");
+        }
+        fclose(out);
+    }
+
+    pthread_mutex_lock(&client_list_lock);
+    pthread_mutex_lock(&client->write_lock);
+    pthread_mutex_unlock(&client_list_lock);
+    FILE *fifo = reply ? fdopen(dup(client->fd), "w") : NULL;
+    if (fifo) {
+        if (client->binary) {
+            // Marks where the reply starts among the frames; the reply itself is the usual text
+            frame_write(client->fd, FRAME_RESYNC, 0, snap->version, NULL, 0);
+        }
+        fwrite(reply, 1, reply_len, fifo);
+        fclose(fifo);
+    }
+    pthread_mutex_unlock(&client->write_lock);
+    snapshot_release(snap);
+    free(reply);
+    free(blocks);
+    return readable;
+}
+
+/*
+ * Returns whether text holds only printable ASCII (32-126) and newlines
+ */
+bool is_printable_text(const char *text, size_t len) {
+    size_t i = scan->find_non_printable(text, len);
+    while (i < len) {
+        if (text[i] != '\n') {
+            return false;
+        }
+        i++;
+        i += scan->find_non_printable(text + i, len - i);
+    }
+    return true;
+}
+
+/*
+ * Stages a streamed paste whose FRAME_PASTE_BEGIN has been read. The text is read straight
+ * into *line behind a "PASTE <pos> <len> " header, so the whole paste is queued as one command.
+ * Returns READ_CLOSED if the paste is too long, malformed or cut short, and READ_INVALID if it
+ * arrived whole but holds anything but printable ASCII and newlines.
+ */
+read_status read_paste(FILE *c2s, frame_span span, char **line, size_t *capacity) {
+    if (span.len == 0 || span.len > FRAME_MAX_PASTE_SIZE) {
+        return READ_CLOSED;
+    }
+    char header[LINE_LEN];
+    size_t header_len = (size_t)snprintf(header, sizeof(header), "PASTE %llu %llu ",
+                                         (unsigned long long)span.pos, (unsigned long long)span.len);
+    size_t needed = header_len + span.len + 1;
+    if (*capacity < needed) {
+        *line = realloc(*line, needed);
+        *capacity = needed;
+    }
+    memcpy(*line, header, header_len);
+
+    // Each part lands where it belongs; only the end frame may follow the last one
+    char *text = *line + header_len;
+    size_t received = 0;
+    frame_header h;
+    while (frame_read_into(c2s, &h, text + received, span.len - received)) {
+        if (h.opcode == FRAME_PASTE_END) {
+            text[received] = '\0';
+            if (received != span.len) {
+                return READ_CLOSED;
+            }
+            return is_printable_text(text, received) ? READ_COMMAND : READ_INVALID;
+        }
+        if (h.opcode != FRAME_PASTE_DATA) {
+            return READ_CLOSED;
+        }
+        received += h.length;
+    }
+    return READ_CLOSED;
+}
+
+/*
+ * Reads the next message from a client into *line (grown as needed), without its line ending.
+ * - Text clients send one line per message, cut at LINE_LEN as before. A CRLF ending is
+ *   accepted.
+ * - Binary clients send frames: a command's payload is copied as is, a disconnect reads as
+ *   "DISCONNECT", a resync frame is followed by the usual text request line, and a streamed
+ *   paste is assembled into a single PASTE command.
+ * A command must be printable ASCII, as the client checks before sending it: a newline,
+ * carriage return or NUL would let it forge extra lines in the EDIT entry every client parses.
+ * Such a command reads as READ_INVALID and only it is dropped. READ_CLOSED means the client
+ * has gone or sent a message whose end cannot be found, including a RESYNC request line that
+ * is not printable, since the signature lines after it could not be told apart from commands.
+ */
+read_status read_command(FILE *c2s, bool binary, char **line, size_t *capacity) {
+    size_t len;
+    if (!binary) {
+        if (!fgets(*line, LINE_LEN, c2s)) {
+            return READ_CLOSED;
+        }
+        len = strcspn(*line, "\n");
+        if (len > 0 && (*line)[len - 1] == '\r') {
+            len--;
+        }
+        (*line)[len] = '\0';
+        return scan->find_non_printable(*line, len) == len ? READ_COMMAND : READ_INVALID;
+    }
+    frame_header h;
+    if (!frame_read(c2s, &h, line, capacity, FRAME_MAX_COMMAND_SIZE)) {
+        return READ_CLOSED;
+    }
+    len = h.length;
+    if (h.opcode == FRAME_DISCONNECT) {
+        strcpy(*line, "DISCONNECT"); // A payload buffer is always at least LINE_LEN bytes
+        return READ_COMMAND;
+    } else if (h.opcode == FRAME_RESYNC) {
+        if (!fgets(*line, LINE_LEN, c2s)) {
+            return READ_CLOSED;
+        }
+        len = strcspn(*line, "\n");
+        (*line)[len] = '\0';
+        return scan->find_non_printable(*line, len) == len ? READ_COMMAND : READ_CLOSED;
+    } else if (h.opcode == FRAME_PASTE_BEGIN) {
+        frame_span span;
+        if (h.length != sizeof(span)) {
+            return READ_CLOSED;
+        }
+        memcpy(&span, *line, sizeof(span));
+        return read_paste(c2s, span, line, capacity);
+    } else if (h.opcode != FRAME_COMMAND) {
+        return READ_CLOSED;
+    }
+    return scan->find_non_printable(*line, len) == len ? READ_COMMAND : READ_INVALID;
+}
+
+/*
+ * Tells a client its last command was dropped as invalid, and logs it. The reply goes to this
+ * client only, as an entry of its LOG?: a text line, or a FRAME_EDIT outside any block.
+ */
+void reject_invalid(client_pipe *client, const char *username) {
+    fprintf(stderr, "Dropped a command from %s that is not printable ASCII\n", username);
+    char *line = format_edit_line(username, "(invalid)", UNKNOWN_COMMAND);
+    pthread_mutex_lock(&client->write_lock);
+    if (client->binary) {
+        frame_write(client->fd, FRAME_EDIT, 0, 0, line, strlen(line));
+    } else {
+        dprintf(client->fd, "%s\n", line);
+    }
+    pthread_mutex_unlock(&client->write_lock);
+    free(line);
+}
+
 /*
  * Handles a new client connection:
  * - Creates and manages client-specific FIFOs
@@ -220,11 +664,23 @@ void *client_handler(void *arg) {
     int fd_c2s = open(fifo_c2s, O_RDONLY);
     int fd_s2c = open(fifo_s2c, O_WRONLY);
 
-    // Read username from client
+    // Read username from client, optionally followed by "SINCE <version>" of its cached copy and
+    // by "BINARY" if it wants framed messages once the handshake is over
     char username[USERNAME_LEN];
     ssize_t n = read(fd_c2s, username, sizeof(username) - 1);
-    username[n] = '\0';
+    username[n > 0 ? n : 0] = '\0';
     username[strcspn(username, "\n")] = '\0';
+    char *binary_token = strstr(username, " " FRAME_BINARY_TOKEN);
+    bool binary = (binary_token != NULL);
+    if (binary_token) {
+        *binary_token = '\0';
+    }
+    unsigned long long since_version = 0;
+    char *since = strstr(username, " SINCE ");
+    bool has_since = since && sscanf(since, " SINCE %llu", &since_version) == 1;
+    if (since) {
+        *since = '\0';
+    }
 
     // Check user's role
     char role[ROLE_LEN];
@@ -241,12 +697,23 @@ void *client_handler(void *arg) {
         pthread_exit(NULL);
     }
 
-    // Add client pipe to broadcast list
+    // Add client pipe to broadcast list and pin the version it will be synced to.
+    // Its write lock is held until the sync is sent so broadcasts queue up behind it.
     pthread_mutex_lock(&client_list_lock);
     client_pipe *new_client = malloc(sizeof(client_pipe));
     new_client->fd = fd_s2c;
+    new_client->binary = binary;
+    new_client->user_id = next_user_id++;
+    pthread_mutex_init(&new_client->write_lock, NULL);
+    pthread_mutex_lock(&new_client->write_lock);
     new_client->next = client_list;
     client_list = new_client;
+    snapshot *snap = snapshot_pin(&snapshots);
+
+    // A cached copy can be brought up to date from the history if every block after it is
+    // still held. Blocks appended from here on reach the client through the broadcast instead.
+    bool catch_up = has_since && since_version <= snap->version && history_covers(&history, since_version);
+    size_t history_end = history_length(&history);
     pthread_mutex_unlock(&client_list_lock);
 
     // Increment client count
@@ -254,16 +721,27 @@ void *client_handler(void *arg) {
     client_count++;
     pthread_mutex_unlock(&client_count_lock);
 
-    // Send role to client
-    dprintf(fd_s2c, "%s\n", role);
-    // Send current document version to client
-    dprintf(fd_s2c, "%llu\n", (unsigned long long)doc->version);
-    // Flatten document and send its contents
-    char *flat = markdown_flatten(doc);
-    size_t doc_len = strlen(flat);
-    dprintf(fd_s2c, "%zu\n", doc_len);
-    write(fd_s2c, flat, doc_len);
-    free(flat);
+    // Send role to client, confirming binary framing if it was asked for along with the id its frames carry
+    if (binary) {
+        dprintf(fd_s2c, "%s " FRAME_BINARY_TOKEN " %u\n", role, new_client->user_id);
+    } else {
+        dprintf(fd_s2c, "%s\n", role);
+    }
+    FILE *catch_up_out = catch_up ? fdopen(dup(fd_s2c), "w") : NULL;
+    if (catch_up_out) {
+        // Stream only the broadcast blocks the client missed, buffered into few writes
+        fprintf(catch_up_out, "CATCHUP %llu\n", since_version);
+        history_print(&history, since_version + 1, history_end, catch_up_out);
+        fprintf(catch_up_out, "CATCHUP_END\n");
+        fclose(catch_up_out);
+    } else {
+        // Send the pinned version and its contents straight from the shared chunks
+        dprintf(fd_s2c, "%llu\n", (unsigned long long)snap->version);
+        dprintf(fd_s2c, "%zu\n", snap->length);
+        snapshot_write(snap, fd_s2c);
+    }
+    pthread_mutex_unlock(&new_client->write_lock);
+    snapshot_release(snap);
 
     // Wrap fd_c2s in a FILE* for simpler line-based reading
     FILE *c2s = fdopen(fd_c2s, "r");
@@ -271,43 +749,42 @@ void *client_handler(void *arg) {
         pthread_exit(NULL);
     }
 
-    char command_line[LINE_LEN];
-    while (fgets(command_line, sizeof(command_line), c2s)) {
-        command_line[strcspn(command_line, "\n")] = '\0';
+    // Commands from this client go to its own queue, which keeps them in the order sent
+    command_source *commands = command_inbox_open(&cmd_inbox);
+
+    char *command_line = malloc(LINE_LEN);
+    size_t command_capacity = LINE_LEN;
+    read_status status;
+    while ((status = read_command(c2s, binary, &command_line, &command_capacity)) != READ_CLOSED) {
+        if (status == READ_INVALID) {
+            reject_invalid(new_client, username);
+            continue;
+        }
 
         // Client wants to disconnect
         if (strcmp(command_line, "DISCONNECT") == 0) {
             break;
         }
 
-        uint64_t client_version = doc->version;
-
-        // Queue command to be stored in log although it will be rejected
-        if (strcmp(role, "read") == 0 &&
-            (strncmp(command_line, "INSERT", 6) == 0 || // 6 = strlen("INSERT")
-             strncmp(command_line, "DEL", 3) == 0 || // 3 = strlen("DEL")
-             strncmp(command_line, "NEWLINE", 7) == 0 || // 7 = strlen("NEWLINE")
-             strncmp(command_line, "HEADING", 7) == 0 || // 7 = strlen("HEADING")
-             strncmp(command_line, "BOLD", 4) == 0 || // 4 = strlen("BOLD")
-             strncmp(command_line, "ITALIC", 6) == 0 || // 6 = strlen("ITALIC")
-             strncmp(command_line, "BLOCKQUOTE", 10) == 0 || // 10 = strlen("BLOCKQUOTE")
-             strncmp(command_line, "ORDERED_LIST", 12) == 0 || // 12 = strlen("ORDERED_LIST")
-             strncmp(command_line, "UNORDERED_LIST", 14) == 0 || // 14 = strlen("UNORDERED_LIST")
-             strncmp(command_line, "CODE", 4) == 0 || // 4 = strlen("CODE")
-             strncmp(command_line, "HORIZONTAL_RULE", 15) == 0 || // 15 = strlen("HORIZONTAL_RULE")
-             strncmp(command_line, "LINK", 4) == 0)) { // 4 = strlen("LINK")
-
-            pthread_mutex_lock(&doc_lock);
-            enqueue_command(&cmd_queue, username, role, command_line, doc->version);
-            pthread_mutex_unlock(&doc_lock);
+        // Client wants its copy brought back in line with the current version
+        if (strncmp(command_line, "RESYNC ", 7) == 0) { // 7 = strlen("RESYNC ")
+            if (!send_resync(c2s, new_client, command_line)) {
+                break;
+            }
             continue;
         }
 
-        // Queue the command for processing in the broadcast thread
-        pthread_mutex_lock(&doc_lock);
-        enqueue_command(&cmd_queue, username, role, command_line, client_version);
-        pthread_mutex_unlock(&doc_lock);
+        uint64_t client_version = snapshot_current_version(&snapshots);
+
+        // Queue the command for processing in the broadcast thread. Edits from read-only users are
+        // queued as well so their rejection is logged. The push is lock-free, so this never waits
+        // for a tick in progress.
+        parsed_command op;
+        command_parse(command_line, &op); // Tokenized here, outside doc_lock, and never again
+        enqueue_command(&commands->queue, username, new_client->user_id, role, command_line, &op, client_version);
     }
+    command_source_close(commands); // Freed by the broadcast thread once drained
+    free(command_line);
 
     // Handle client disconnection
     pthread_mutex_lock(&client_count_lock);
@@ -321,6 +798,7 @@ void *client_handler(void *arg) {
         if ((*curr)->fd == fd_s2c) {
             client_pipe *to_remove = *curr;
             *curr = (*curr)->next;
+            pthread_mutex_destroy(&to_remove->write_lock);
             free(to_remove);
             break;
         }
@@ -338,6 +816,24 @@ void *client_handler(void *arg) {
     pthread_exit(NULL);
 }
 
+/*
+ * Parses the version given to the console's "LOG? <version>": a decimal number that fits in
+ * 64 bits and nothing after it. Signs and leading spaces, which strtoull would skip, are refused.
+ */
+bool parse_version(const char *arg, uint64_t *version) {
+    if (*arg < '0' || *arg > '9') {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, BASE_DECIMAL);
+    if (errno == ERANGE || *end != '\0') {
+        return false;
+    }
+    *version = v;
+    return true;
+}
+
 /*
  * Signal-waiting thread that handles new client connections. 
  * - Waits for SIGRTMIN from new clients (blocks on sigwaitinfo() for signal safety).
@@ -384,7 +880,23 @@ void *sigwait_thread(void *arg) {
  */
 int main(int argc, char *argv[]) {
     int time_interval;
-    if (argc != 2) {
+    size_t log_retention = HISTORY_DEFAULT_RETAINED_SEGMENTS;
+    bool valid_args = (argc >= 2);
+    for (int i = 2; valid_args && i < argc; i++) {
+        if (strcmp(argv[i], "--log-retention") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            // Number of history segments kept in memory before older ones are spilled to disk
+            log_retention = (size_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rebase") == 0) {
+            // Transform stale commands across the edits committed since instead of rejecting them
+            rebase_stale = true;
+        } else if (strcmp(argv[i], "--group-commit") == 0) {
+            // Commit every command of a tick together as one version
+            group_commit = true;
+        } else {
+            valid_args = false;
+        }
+    }
+    if (!valid_args) {
         perror("Invalid number of arguments\n");
         return 0;
     }
@@ -398,6 +910,43 @@ int main(int argc, char *argv[]) {
     sigaddset(&sigset, SIGRTMIN);
     pthread_sigmask(SIG_BLOCK, &sigset, NULL);
 
+    // A client that exits right after DISCONNECT may close its FIFO before the broadcast thread
+    // drops it from the list. The write must fail with EPIPE instead of killing the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    // Initialise shared document, recover the edits journaled before the last shutdown or crash,
+    // and publish the first snapshot before any thread can read it
+    doc = markdown_init();
+    if (checkpoint_load(doc, CHECKPOINT_PATH) < 0) {
+        fprintf(stderr, "Checkpoint %s is unreadable or corrupt\n", CHECKPOINT_PATH);
+        return 1;
+    }
+    checkpoint_version = doc->version;
+    // A retired segment is only left behind if the checkpoint meant to cover it never finished
+    long retired = journal_replay(JOURNAL_RETIRED_PATH, doc);
+    long recovered = (retired < 0) ? -1 : journal_replay(JOURNAL_PATH, doc);
+    if (recovered < 0) {
+        perror("journal replay");
+    } else if (retired + recovered > 0) {
+        printf("Recovered %ld edits (version %llu)\n", retired + recovered, (unsigned long long)doc->version);
+    }
+    current_version = doc->version;
+    if (!journal_open(&wal, JOURNAL_PATH)) {
+        return 1;
+    }
+    snapshot_store_init(&snapshots, doc);
+    command_inbox_init(&cmd_inbox);
+    history_init(&history, current_version, log_retention, HISTORY_SPILL_PATH);
+    if (rebase_stale) {
+        rebase_log_init(&rebase, doc->version, REBASE_WINDOW_VERSIONS);
+    }
+    if (group_commit) {
+        arena_init(&tick_edits.storage);
+        range_set_init(&tick_edits.inserts, &tick_edits.storage);
+        range_set_init(&tick_edits.deletes, &tick_edits.storage);
+        range_set_init(&tick_edits.interiors, &tick_edits.storage);
+    }
+
     // Create the thread to wait for client SIGRTMIN signals
     pthread_t sig_thread;
     if (pthread_create(&sig_thread, NULL, sigwait_thread, NULL) != 0) {
@@ -410,38 +959,51 @@ int main(int argc, char *argv[]) {
     pthread_create(&bcast_thread, NULL, broadcast_thread, &time_interval);
     pthread_detach(bcast_thread);
 
-    // Initialise shared document
-    doc = markdown_init();
-
     // Server terminal loop for user commands
     char input[MAX_INPUT_SIZE];
+    uint64_t from_version;
     while (1) {
         while (fgets(input, sizeof(input), stdin) != NULL) {
             input[strcspn(input, "\n")] = '\0';
             if (strcmp(input, "DOC?") == 0) {
-                // Print current document content to terminal
-                char *flat = markdown_flatten(doc);
-                printf("%s\n", flat);
-                free(flat);
+                // Print the latest committed version without waiting for the broadcast tick
+                snapshot *snap = snapshot_pin(&snapshots);
+                snapshot_print(snap, stdout);
+                snapshot_release(snap);
+                printf("\n");
+            } else if (strcmp(input, "STATS?") == 0) {
+                // Print the document's chunk allocation and fragmentation counters
+                pthread_mutex_lock(&doc_lock);
+                chunk_pool_stats stats = doc->pool.stats;
+                fragmentation_stats frag;
+                compact_stats(doc, &frag);
+                pthread_mutex_unlock(&doc_lock);
+                printf("CHUNKS live %zu allocated %zu freed %zu retired %zu\n",
+                       stats.live_chunks, stats.allocations, stats.frees, stats.retired_chunks);
+                printf("SLABS held %zu allocated %zu released %zu\n",
+                       stats.slabs, stats.slab_allocations, stats.slab_releases);
+                printf("NODES live %zu retired %zu\n", stats.live_nodes, stats.retired_nodes);
+                printf("FRAGMENTATION chunks %zu underfull %zu bytes %zu fill %.2f compacted %zu\n",
+                       frag.chunks, frag.underfull_chunks, frag.bytes, frag.fill_ratio, frag.compacted_chunks);
             } else if (strcmp(input, "LOG?") == 0) {
                 // Print full edit history (including successes and rejections)
-                version_log *vlog = log_head;
-                while (vlog) {
-                    printf("VERSION %d\n", vlog->version_number);
-                    log_entry *e = vlog->entries;
-                    while (e) {
-                        printf("%s\n", e->line);
-                        e = e->next;
-                    }
-                    printf("END\n");
-                    vlog = vlog->next;
+                history_print(&history, 0, SIZE_MAX, stdout);
+            } else if (strncmp(input, "LOG? ", 5) == 0) { // 5 = strlen("LOG? ")
+                // Print the edit history from a given version onwards
+                if (parse_version(input + 5, &from_version)) {
+                    history_print(&history, from_version, SIZE_MAX, stdout);
+                } else {
+                    printf("LOG? rejected, invalid version '%s'\n", input + 5);
                 }
             } else if (strcmp(input, "QUIT") == 0) {
                 // Only allow server to shutdown if no clients are connected
                 pthread_mutex_lock(&client_count_lock);
                 if (client_count == 0) {
-                    // Final commit and save document to doc.md
+                    // Final commit, checkpoint and save document to doc.md
+                    pthread_mutex_lock(&doc_lock);
                     markdown_increment_version(doc);
+                    snapshot_publish(&snapshots, doc);
+                    write_checkpoint();
                     FILE *outfile = fopen("doc.md", "w");
                     if (outfile) {
                         markdown_print(doc, outfile);
@@ -449,14 +1011,19 @@ int main(int argc, char *argv[]) {
                     }
                     
                     // Clean up: free any remaining queued commands, document and logs
-                    free_command_queue(&cmd_queue);
+                    command_inbox_destroy(&cmd_inbox);
+                    journal_close(&wal);
+                    snapshot_store_destroy(&snapshots);
                     markdown_free(doc);
-                    free_logs();
+                    history_free(&history);
+                    if (rebase_stale) {
+                        rebase_log_free(&rebase);
+                    }
                     pthread_mutex_unlock(&client_count_lock);
                     
-                    // Destroy all mutexes before exit
+                    // Destroy the remaining mutexes before exit. doc_lock stays held so the
+                    // broadcast thread cannot wake up and touch the freed document.
                     pthread_mutex_destroy(&client_count_lock);
-                    pthread_mutex_destroy(&doc_lock);
                     pthread_mutex_destroy(&client_list_lock);
                     exit(0);
                 } else {
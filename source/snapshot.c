@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../libs/snapshot.h"
+#include "../libs/chunk_pool.h"
+#include "../libs/chunk_tree.h"
+
+// HELPER FUNCTIONS
+
+// Captures the document's tree; the nodes and chunks are shared, not copied
+static snapshot *snapshot_build(const document *doc) {
+    snapshot *snap = malloc(sizeof(snapshot));
+    snap->version = doc->version;
+    snap->length = doc->length;
+    snap->root = doc->root;
+    atomic_init(&snap->refs, 1); // Held by the store while it is current
+    snap->prev = NULL;
+    snap->next = NULL;
+    return snap;
+}
+
+// Unlinks a snapshot from the writer's list and frees it
+static void snapshot_free(snapshot_store *store, snapshot *snap) {
+    if (snap->prev) {
+        snap->prev->next = snap->next;
+    } else {
+        store->oldest = snap->next;
+    }
+    if (snap->next) {
+        snap->next->prev = snap->prev;
+    } else {
+        store->newest = snap->prev;
+    }
+    free(snap);
+}
+
+// STORE
+
+// Turns on deferred reclamation and publishes the starting version
+void snapshot_store_init(snapshot_store *store, document *doc) {
+    atomic_init(&store->current, NULL);
+    atomic_init(&store->current_version, 0);
+    atomic_init(&store->pinning, 0);
+    store->oldest = NULL;
+    store->newest = NULL;
+    doc->pool.defer_reclaim = true;
+    snapshot_publish(store, doc);
+}
+
+// Frees the snapshots still linked into the store, pinned or not
+void snapshot_store_destroy(snapshot_store *store) {
+    while (store->oldest) {
+        snapshot_free(store, store->oldest);
+    }
+    atomic_store(&store->current, NULL);
+}
+
+// Freezes the tree by starting a new epoch, then swaps the current pointer
+void snapshot_publish(snapshot_store *store, document *doc) {
+    snapshot *snap = snapshot_build(doc);
+    snap->prev = store->newest;
+    if (store->newest) {
+        store->newest->next = snap;
+    } else {
+        store->oldest = snap;
+    }
+    store->newest = snap;
+
+    // Every node reachable from the root is now shared with readers, so later commits copy it
+    doc->tree_epoch++;
+
+    snapshot *old = atomic_exchange(&store->current, snap);
+    atomic_store(&store->current_version, snap->version);
+    if (old) {
+        atomic_fetch_sub(&old->refs, 1);
+    }
+    snapshot_reclaim(store, doc);
+}
+
+// A reader that loaded an old current pointer may not have counted its reference yet, so
+// unused snapshots are only freed while no reader is between those two steps
+void snapshot_reclaim(snapshot_store *store, document *doc) {
+    if (atomic_load(&store->pinning) == 0) {
+        snapshot *snap = store->oldest;
+        while (snap) {
+            snapshot *next = snap->next;
+            if (atomic_load(&snap->refs) == 0) {
+                snapshot_free(store, snap);
+            }
+            snap = next;
+        }
+    }
+    // Chunks and nodes retired before the oldest live version can no longer be seen by anyone
+    chunk_pool_reclaim(&doc->pool, store->oldest->version);
+}
+
+// READERS
+
+// Announces the pin before loading the pointer so the writer cannot free it in between
+snapshot *snapshot_pin(snapshot_store *store) {
+    atomic_fetch_add(&store->pinning, 1);
+    snapshot *snap = atomic_load(&store->current);
+    atomic_fetch_add(&snap->refs, 1);
+    atomic_fetch_sub(&store->pinning, 1);
+    return snap;
+}
+
+// The writer's next publish or reclaim frees the snapshot and what only it could see
+void snapshot_release(snapshot *snap) {
+    atomic_fetch_sub(&snap->refs, 1);
+}
+
+// Reads the published version without touching the live document
+uint64_t snapshot_current_version(snapshot_store *store) {
+    return atomic_load(&store->current_version);
+}
+
+// Writes each chunk's bytes in document order
+void snapshot_print(const snapshot *snap, FILE *stream) {
+    chunk_iter it;
+    chunk_iter_init(&it, snap->root);
+    for (const chunk *c; (c = chunk_iter_next(&it)) != NULL; ) {
+        fwrite(c->data, 1, c->length, stream);
+    }
+    chunk_iter_free(&it);
+}
+
+// Same as snapshot_print but for a raw descriptor such as a client FIFO
+void snapshot_write(const snapshot *snap, int fd) {
+    chunk_iter it;
+    chunk_iter_init(&it, snap->root);
+    for (const chunk *c; (c = chunk_iter_next(&it)) != NULL; ) {
+        const char *data = c->data;
+        size_t left = c->length;
+        while (left > 0) {
+            ssize_t n = write(fd, data, left);
+            if (n <= 0) {
+                chunk_iter_free(&it);
+                return;
+            }
+            data += n;
+            left -= (size_t)n;
+        }
+    }
+    chunk_iter_free(&it);
+}
+
+// Concatenates the chunks the snapshot captured
+char *snapshot_flatten(const snapshot *snap) {
+    char *buf = malloc(snap->length + 1);
+    size_t offset = 0;
+    chunk_iter it;
+    chunk_iter_init(&it, snap->root);
+    for (const chunk *c; (c = chunk_iter_next(&it)) != NULL; ) {
+        memcpy(buf + offset, c->data, c->length);
+        offset += c->length;
+    }
+    chunk_iter_free(&it);
+    buf[snap->length] = '\0';
+    return buf;
+}
@@ -0,0 +1,20 @@
+#!/bin/bash
+# Binary framing: a binary client sends a command longer than the text protocol allows, edits
+# alongside a text client, and RESYNCs; both copies and the saved document agree.
+. "$(dirname "$0")/common.sh"
+
+long=$(printf 'x%.0s' $(seq 1 1000))
+start_server 50
+{ echo "INSERT 0 hello world"; sleep 0.2; echo "INSERT 0 $long"; sleep 0.2; echo "BOLD 1000 1005"; sleep 0.2
+  echo "RESYNC"; echo "DOC?"; echo "DISCONNECT"; } | client william --binary > binary_out 2>&1
+{ echo "INSERT 0 $long"; echo "INSERT 0 >"; sleep 0.2; echo "DOC?"; echo "DISCONNECT"; } |
+    client admin > text_out 2>&1
+stop_server
+
+expected=">$long**hello** world"
+expect_file doc.md "$expected"
+expect_line binary_out "^RESYNC version 3 "
+[ "$(tail -n 1 binary_out)" = "$long**hello** world" ] || fail "binary client's copy differs"
+expect_line text_out "command too long"
+[ "$(tail -n 1 text_out)" = "$expected" ] || fail "text client's copy differs from doc.md"
+echo "binary: ok"
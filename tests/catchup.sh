@@ -0,0 +1,20 @@
+#!/bin/bash
+# A returning client with a cached copy receives only the versions it missed (CATCHUP) and
+# ends up with the same document as the server.
+. "$(dirname "$0")/common.sh"
+
+start_server 50
+{ echo "INSERT 0 hello world"; sleep 0.2; echo "BOLD 0 5"; sleep 0.2; echo "DISCONNECT"; } |
+    client william > /dev/null 2>&1
+[ -s .william.doc.cache ] || fail "no cache written"
+{ for i in 1 2 3; do echo "INSERT 0 a$i "; sleep 0.1; done; echo "DISCONNECT"; } | client admin > /dev/null 2>&1
+{ echo "LOG?"; echo "INSERT 0 Z"; sleep 0.2; echo "DOC?"; echo "DISCONNECT"; } | client william > returning_out 2>&1
+stop_server
+
+expected="Za3 a2 a1 **hello** world"
+expect_file doc.md "$expected"
+# A full transfer would carry only the text, not the edits made while the client was away
+expect_line returning_out "^EDIT admin INSERT 0 a1  SUCCESS$"
+expect_line returning_out "^EDIT admin INSERT 0 a3  SUCCESS$"
+[ "$(tail -n 1 returning_out)" = "$expected" ] || fail "returning client's copy differs"
+echo "catchup: ok"
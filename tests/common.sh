@@ -0,0 +1,77 @@
+# Shared helpers for the end-to-end tests. Each test runs in its own scratch directory so the
+# server's document, journal, checkpoint and FIFOs never touch the working tree.
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+SRV=
+cp "$ROOT/roles.txt" "$WORK"
+cd "$WORK" || exit 1
+
+cleanup() {
+    exec 3>&- 2>/dev/null
+    if [ -n "$SRV" ]; then
+        kill "$SRV" 2>/dev/null
+        wait "$SRV" 2>/dev/null
+    fi
+    cd / && rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# Prints a message and fails the test
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# Starts the server with the given arguments. Its console is fed through fd 3, which stays open
+# so the server never sees end of file on stdin.
+start_server() {
+    rm -f console
+    mkfifo console
+    "$ROOT/server" "$@" < console > server_out 2>&1 &
+    SRV=$!
+    exec 3> console
+    sleep 0.3
+}
+
+# Sends a line to the server console
+console() {
+    echo "$1" >&3
+}
+
+# Asks the server to save and exit, retrying while disconnected clients are still counted
+stop_server() {
+    for _ in $(seq 1 25); do
+        console "QUIT"
+        sleep 0.2
+        if ! kill -0 "$SRV" 2>/dev/null; then
+            wait "$SRV"
+            exec 3>&-
+            SRV=
+            return
+        fi
+    done
+    fail "server did not quit"
+}
+
+# Runs a client against the server: client <username> [--binary], commands on stdin
+client() {
+    "$ROOT/client" "$SRV" "$@"
+}
+
+# Fails unless the file holds exactly the expected text
+expect_file() {
+    printf '%s' "$2" | cmp -s - "$1" || fail "$1 is '$(cat "$1")', expected '$2'"
+}
+
+# Fails unless some line of the file matches the pattern
+expect_line() {
+    grep -aq -- "$2" "$1" || fail "$1 has no line matching '$2'"
+}
+
+# Fails if some line of the file matches the pattern
+reject_line() {
+    if grep -aq -- "$2" "$1"; then
+        fail "$1 has a line matching '$2'"
+    fi
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Text protocol: a writer formats a line, a read-only client sees the same document and has its
+# edit rejected, the console's LOG? <version> refuses a malformed version, and the server saves
+# the result on QUIT.
+. "$(dirname "$0")/common.sh"
+
+start_server 50
+{ echo "INSERT 0 hello world"; sleep 0.2; echo "BOLD 0 5"; sleep 0.2; echo "NEWLINE 0"; sleep 0.2
+  echo "ORDERED_LIST 0"; sleep 0.2; echo "HEADING 2 0"; sleep 0.2; echo "DOC?"; echo "DISCONNECT"; } |
+    client william > writer_out 2>&1
+{ echo "PERM?"; echo "INSERT 0 nope"; sleep 0.2; echo "DOC?"; echo "LOG?"; echo "DISCONNECT"; } |
+    client user2 > reader_out 2>&1
+console "LOG? 3"
+console "LOG? 3abc"
+console "LOG? -1"
+sleep 0.2
+stop_server
+
+expected=$'## 1. \n**hello** world'
+expect_file doc.md "$expected"
+expect_line reader_out "^read$"
+expect_line reader_out "^EDIT user2 INSERT 0 nope Reject UNAUTHORISED$"
+expect_line server_out "^VERSION 3 "
+reject_line server_out "^VERSION [12] "
+expect_line server_out "^LOG? rejected, invalid version '3abc'$"
+expect_line server_out "^LOG? rejected, invalid version '-1'$"
+[ "$(tail -n 2 writer_out)" = "$expected" ] || fail "writer's copy differs from doc.md"
+echo "e2e: ok"
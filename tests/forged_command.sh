@@ -0,0 +1,16 @@
+#!/bin/bash
+# A binary command may not smuggle a newline: only that command is rejected, the sender stays
+# connected, nothing is applied, and text clients never see the forged primitive line.
+. "$(dirname "$0")/common.sh"
+
+start_server 50
+{ echo "INSERT 0 base"; sleep 0.2; echo "DISCONNECT"; } | client william > /dev/null 2>&1
+"$ROOT/frame_client" "$SRV" admin 'INSERT 0 x\nOP D 0 100' > forged_out 2>&1
+{ sleep 0.2; echo "DOC?"; echo "LOG?"; echo "DISCONNECT"; } | client william > watcher_out 2>&1
+stop_server
+
+expect_file forged_out $'rejected\ndisconnected\n'
+expect_file doc.md "base"
+expect_line watcher_out "^base$"
+reject_line watcher_out "OP D 0 100"
+echo "forged_command: ok"
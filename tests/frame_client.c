@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../libs/frame.h"
+
+#define FIFO_NAME_LEN 64
+#define LINE_LEN 256
+#define EOF_TIMEOUT_SECONDS 5 // How long the server gets to drop the connection
+
+// Connects as a binary client and sends one FRAME_COMMAND holding the payload exactly as given
+// (with "\n" decoded), which the real client would refuse to send. Prints "rejected" if the
+// server answers with a Reject UNKNOWN_COMMAND entry, after which it sends DISCONNECT. Then
+// prints "disconnected" once the server closes the connection, or "connected" if it keeps it
+// open until the timeout.
+// Usage: frame_client <server_pid> <username> <payload>
+
+// HELPER FUNCTIONS
+
+// Decodes "\n" escapes in place and returns the decoded length
+static size_t decode(char *s) {
+    size_t n = 0;
+    for (size_t i = 0; s[i]; i++) {
+        if (s[i] == '\\' && s[i + 1] == 'n') {
+            s[n++] = '\n';
+            i++;
+        } else {
+            s[n++] = s[i];
+        }
+    }
+    return n;
+}
+
+// Gives up waiting for end of file
+static void on_alarm(int sig) {
+    (void)sig;
+    printf("connected\n");
+    exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <server_pid> <username> <payload>\n", argv[0]);
+        return 2;
+    }
+    pid_t server_pid = (pid_t)atoi(argv[1]);
+
+    // Same handshake as the client: SIGRTMIN to the server, then wait for SIGRTMIN+1
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGRTMIN + 1);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    kill(server_pid, SIGRTMIN);
+    int sig;
+    sigwait(&mask, &sig);
+
+    char fifo_c2s[FIFO_NAME_LEN];
+    char fifo_s2c[FIFO_NAME_LEN];
+    snprintf(fifo_c2s, sizeof(fifo_c2s), "FIFO_C2S_%d", getpid());
+    snprintf(fifo_s2c, sizeof(fifo_s2c), "FIFO_S2C_%d", getpid());
+    int fd_c2s = open(fifo_c2s, O_WRONLY);
+    FILE *s2c = fopen(fifo_s2c, "r");
+    if (fd_c2s < 0 || !s2c) {
+        perror("open");
+        return 2;
+    }
+    dprintf(fd_c2s, "%s " FRAME_BINARY_TOKEN "\n", argv[2]);
+
+    // Role line with our user id, then the version, the length and the document itself
+    char line[LINE_LEN];
+    unsigned user_id = 0;
+    if (!fgets(line, sizeof(line), s2c) || sscanf(line, "%*s " FRAME_BINARY_TOKEN " %u", &user_id) != 1) {
+        fprintf(stderr, "binary framing refused: %s", line);
+        return 2;
+    }
+    size_t length = 0;
+    if (!fgets(line, sizeof(line), s2c) || !fgets(line, sizeof(line), s2c) || sscanf(line, "%zu", &length) != 1) {
+        fprintf(stderr, "no document\n");
+        return 2;
+    }
+    for (size_t i = 0; i < length; i++) {
+        getc(s2c);
+    }
+
+    size_t len = decode(argv[3]);
+    frame_write(fd_c2s, FRAME_COMMAND, user_id, 0, argv[3], len);
+
+    // Broadcasts may still arrive; the connection is dropped once they stop at end of file
+    signal(SIGALRM, on_alarm);
+    alarm(EOF_TIMEOUT_SECONDS);
+    frame_header h;
+    char *payload = NULL;
+    size_t capacity = 0;
+    while (frame_read(s2c, &h, &payload, &capacity, UINT32_MAX)) {
+        if (h.opcode == FRAME_EDIT && memmem(payload, h.length, "Reject UNKNOWN_COMMAND", 22)) {
+            printf("rejected\n");
+            fflush(stdout);
+            frame_write(fd_c2s, FRAME_DISCONNECT, user_id, 0, NULL, 0);
+        }
+    }
+    free(payload);
+    printf("disconnected\n");
+    return 0;
+}
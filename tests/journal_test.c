@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "unit.h"
+#include "../libs/journal.h"
+#include "../libs/markdown.h"
+#include "../libs/ops.h"
+
+#define MAX_RECORDS 6
+
+/*
+ * One journal record as the server appends it. A group-commit tick is a run of records whose
+ * primitives carry no OPS_COMMIT_LINE, closed by a record holding only that line.
+ */
+typedef struct {
+    uint64_t version;
+    const char *user;
+    const char *command;
+    const char *ops; // NULL for a JOURNAL_COMMAND record
+} record;
+
+#define COMMIT(v) { v, "", "", OPS_COMMIT_LINE }
+
+static const struct {
+    const char *name;
+    record records[MAX_RECORDS];
+    size_t count;
+    size_t kept; // Leading records left in the file after replay
+    long expected_applied;
+    uint64_t expected_version;
+    const char *expected_text;
+} cases[] = {
+    { "one version per command",
+      { { 1, "william", "INSERT 0 hello", "OP I 0 5 hello\nOP C" },
+        { 2, "william", "INSERT 5  world", "OP I 5 6  world\nOP C" } },
+      2, 2, 2, 2, "hello world" },
+    { "command records without primitives",
+      { { 1, "william", "INSERT 0 hi", NULL }, { 2, "admin", "BOLD 0 2", NULL } },
+      2, 2, 2, 2, "**hi**" },
+    { "group committed as one version",
+      { { 1, "william", "INSERT 0 hello world", "OP I 0 11 hello world\nOP C" },
+        { 2, "william", "DEL 0 6", "OP D 0 6" },
+        { 2, "admin", "INSERT 11 !", "OP I 11 1 !" },
+        COMMIT(2) },
+      4, 4, 3, 2, "world!" },
+    { "group whose commit record is missing",
+      { { 1, "william", "INSERT 0 hello world", "OP I 0 11 hello world\nOP C" },
+        { 2, "william", "DEL 0 6", "OP D 0 6" },
+        { 2, "admin", "INSERT 11 !", "OP I 11 1 !" } },
+      3, 1, 1, 1, "hello world" },
+    { "missing commit after a committed group",
+      { { 1, "william", "INSERT 0 ab", "OP I 0 2 ab" },
+        COMMIT(1),
+        { 2, "admin", "INSERT 2 c", "OP I 2 1 c" } },
+      3, 2, 1, 1, "ab" },
+    { "group positions refer to the text before its commit",
+      { { 1, "william", "INSERT 0 abc", "OP I 0 3 abc\nOP C" },
+        { 2, "william", "INSERT 0 >", "OP I 0 1 >" },
+        { 2, "admin", "DEL 1 1", "OP D 1 1" },
+        COMMIT(2),
+        { 3, "admin", "INSERT 3 !", "OP I 3 1 !\nOP C" } },
+      5, 5, 4, 3, ">ac!" },
+};
+
+// HELPER FUNCTIONS
+
+// Writes the first count records to a fresh journal at path and returns its size
+static off_t write_journal(const char *path, const record *records, size_t count) {
+    unlink(path);
+    journal j;
+    if (!journal_open(&j, path)) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        journal_append(&j, records[i].version, records[i].user, records[i].command, records[i].ops);
+    }
+    journal_close(&j);
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+// TESTS
+
+static void test_replay(const char *path) {
+    for (size_t i = 0; i < ROWS(cases); i++) {
+        off_t kept_size = write_journal(path, cases[i].records, cases[i].kept);
+        write_journal(path, cases[i].records, cases[i].count);
+
+        document *doc = markdown_init();
+        long applied = journal_replay(path, doc);
+        char *text = markdown_flatten(doc);
+        EXPECT(applied == cases[i].expected_applied, "%s: applied %ld, expected %ld",
+               cases[i].name, applied, cases[i].expected_applied);
+        EXPECT(doc->version == cases[i].expected_version, "%s: version %llu, expected %llu", cases[i].name,
+               (unsigned long long)doc->version, (unsigned long long)cases[i].expected_version);
+        EXPECT(strcmp(text, cases[i].expected_text) == 0, "%s: text \"%s\", expected \"%s\"",
+               cases[i].name, text, cases[i].expected_text);
+        EXPECT(doc->pending == NULL, "%s: edits left pending", cases[i].name);
+
+        // Whatever was not replayed is cut off, so the records appended next follow on cleanly
+        struct stat st;
+        EXPECT(stat(path, &st) == 0 && st.st_size == kept_size, "%s: journal is %lld bytes, expected %lld",
+               cases[i].name, (long long)st.st_size, (long long)kept_size);
+        free(text);
+        markdown_free(doc);
+    }
+}
+
+int main(void) {
+    char path[] = "/tmp/journal_test_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    test_replay(path);
+    unlink(path);
+    return unit_report("journal_test");
+}
@@ -0,0 +1,24 @@
+#!/bin/bash
+# PASTE streams a multi-line text larger than any single frame; rejected pastes change nothing,
+# and the server rebuilds the same document from its checkpoint and journal after a restart.
+. "$(dirname "$0")/common.sh"
+
+for i in $(seq 1 800); do printf 'line %04d %s\n' "$i" "pppppppppppppppppppppppppppppppppppppppp"; done > paste.txt
+start_server 50
+{ echo "INSERT 0 [end]"; sleep 0.2; echo "PASTE 0"; cat paste.txt; echo "PASTE_END"; sleep 0.3
+  echo "PASTE 1"; printf 'bad\x01\n'; echo "PASTE_END"; sleep 0.2; echo "DOC?"; echo "DISCONNECT"; } |
+    client william --binary > paster_out 2> paster_err
+{ echo "PASTE 0"; echo "hi"; echo "PASTE_END"; echo "DISCONNECT"; } | client admin > /dev/null 2> text_err
+stop_server
+
+{ cat paste.txt; printf '[end]'; } > expected
+cmp -s doc.md expected || fail "doc.md does not hold the paste"
+head -c "$(stat -c %s expected)" paster_out | cmp -s - expected || fail "paster's copy differs"
+expect_line paster_err "not printable ASCII"
+expect_line text_err "needs a binary connection"
+
+mv doc.md saved.md
+start_server 50
+stop_server
+cmp -s doc.md saved.md || fail "restart did not recover the document"
+echo "paste: ok"
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unit.h"
+#include "../libs/markdown.h"
+
+// Included rather than linked so the static helpers map_position and surviving_length are in reach
+#include "../source/rebase.c"
+
+#define BASE_TEXT "hello world" // Every rebase case starts from this committed text (11 bytes)
+#define FORMATTED_LEN 128
+
+// One commit used by the map_position and surviving_length tables: 3 bytes inserted at 5,
+// bytes [10, 14) deleted, in a 20-byte document
+static rebase_span sample_spans[] = { { 5, 3 }, { 10, 4 } };
+static const rebase_commit sample = { sample_spans, 1, 1, 20 };
+
+static const struct {
+    const char *name;
+    size_t pos;
+    bool after_inserts;
+    size_t expected;
+} map_cases[] = {
+    { "before every edit", 0, true, 0 },
+    { "insert at the same position, moved past it", 5, true, 8 },
+    { "insert at the same position, kept before it", 5, false, 5 },
+    { "at the start of a deletion", 10, true, 13 },
+    { "inside a deletion", 12, true, 13 },
+    { "at the end of a deletion", 14, true, 13 },
+    { "end of the document", 20, true, 19 },
+};
+
+static const struct {
+    const char *name;
+    size_t start;
+    size_t end;
+    size_t expected;
+} surviving_cases[] = {
+    { "untouched range", 0, 5, 5 },
+    { "range ending at the edge of the deletion", 6, 10, 4 },
+    { "range starting at the edge of the deletion", 14, 18, 4 },
+    { "range overlapping the start of the deletion", 8, 12, 2 },
+    { "range covering the deletion", 9, 15, 2 },
+    { "fully deleted range", 10, 14, 0 },
+    { "range inside the deletion", 11, 13, 0 },
+};
+
+// A stale command issued at version 1 while one concurrent command was committed as version 2
+static const struct {
+    const char *name;
+    const char *concurrent;
+    const char *stale;
+    int expected_result;
+    const char *expected; // The rebased command (on SUCCESS)
+} rebase_cases[] = {
+    { "insert at the same position", "INSERT 5 XX", "INSERT 5 !", SUCCESS, "INSERT 7 !" },
+    { "insert after a deletion", "DEL 0 6", "INSERT 11 !", SUCCESS, "INSERT 5 !" },
+    { "point inside deleted text", "DEL 2 6", "NEWLINE 5", SUCCESS, "NEWLINE 2" },
+    { "range at the start edge of a deletion", "DEL 0 5", "BOLD 5 11", SUCCESS, "BOLD 0 6" },
+    { "range at the end edge of a deletion", "DEL 5 6", "BOLD 0 5", SUCCESS, "BOLD 0 5" },
+    { "range keeping text inserted at its edges out", "INSERT 6 >", "ITALIC 6 11", SUCCESS, "ITALIC 7 12" },
+    { "range partly deleted", "DEL 3 4", "CODE 0 8", SUCCESS, "CODE 0 4" },
+    { "fully deleted range", "DEL 2 6", "ITALIC 3 7", DELETED_POSITION, NULL },
+    { "fully deleted delete", "DEL 0 11", "DEL 3 2", DELETED_POSITION, NULL },
+    { "delete running to the end", "INSERT 0 >> ", "DEL 6 100", SUCCESS, "DEL 9 5" },
+    { "delete running to the end past a deletion", "DEL 8 3", "DEL 6 100", SUCCESS, "DEL 6 2" },
+    { "delete at the very end", "INSERT 0 >", "DEL 11 4", SUCCESS, "DEL 12 4" },
+    { "position out of range at its own version", "INSERT 0 x", "INSERT 12 !", INVALID_CURSOR_POS, NULL },
+};
+
+// HELPER FUNCTIONS
+
+// Commits BASE_TEXT as version 1, then the concurrent command as version 2, recording it in log
+static document *two_versions(rebase_log *log, const char *concurrent) {
+    document *doc = markdown_init();
+    markdown_insert(doc, 0, 0, BASE_TEXT);
+    markdown_increment_version(doc);
+    rebase_log_init(log, doc->version, REBASE_WINDOW_VERSIONS);
+    int result = process_command(doc, concurrent, doc->version);
+    EXPECT(result == SUCCESS, "concurrent command \"%s\" failed with %d", concurrent, result);
+    rebase_log_record(log, doc);
+    markdown_increment_version(doc);
+    return doc;
+}
+
+// TESTS
+
+static void test_map_position(void) {
+    for (size_t i = 0; i < ROWS(map_cases); i++) {
+        size_t got = map_position(&sample, map_cases[i].pos, map_cases[i].after_inserts);
+        EXPECT(got == map_cases[i].expected, "map_position, %s: got %zu, expected %zu",
+               map_cases[i].name, got, map_cases[i].expected);
+    }
+}
+
+static void test_surviving_length(void) {
+    for (size_t i = 0; i < ROWS(surviving_cases); i++) {
+        size_t got = surviving_length(&sample, surviving_cases[i].start, surviving_cases[i].end);
+        EXPECT(got == surviving_cases[i].expected, "surviving_length, %s: got %zu, expected %zu",
+               surviving_cases[i].name, got, surviving_cases[i].expected);
+    }
+}
+
+static void test_rebase_command(void) {
+    for (size_t i = 0; i < ROWS(rebase_cases); i++) {
+        rebase_log log;
+        document *doc = two_versions(&log, rebase_cases[i].concurrent);
+        parsed_command cmd;
+        command_parse(rebase_cases[i].stale, &cmd);
+        int result = rebase_command(&log, &cmd, 1, doc->version);
+        EXPECT(result == rebase_cases[i].expected_result, "rebase_command, %s: result %d, expected %d",
+               rebase_cases[i].name, result, rebase_cases[i].expected_result);
+        if (result == SUCCESS && rebase_cases[i].expected) {
+            char formatted[FORMATTED_LEN];
+            command_format(rebase_cases[i].stale, &cmd, formatted, sizeof(formatted));
+            EXPECT(strcmp(formatted, rebase_cases[i].expected) == 0, "rebase_command, %s: got \"%s\", expected \"%s\"",
+                   rebase_cases[i].name, formatted, rebase_cases[i].expected);
+        }
+        rebase_log_free(&log);
+        markdown_free(doc);
+    }
+}
+
+// A version older than the log reaches is refused rather than guessed at
+static void test_outdated_version(void) {
+    rebase_log log;
+    document *doc = two_versions(&log, "INSERT 0 x");
+    parsed_command cmd;
+    command_parse("INSERT 0 !", &cmd);
+    int result = rebase_command(&log, &cmd, 0, doc->version);
+    EXPECT(result == OUTDATED_VERSION, "rebase_command from before the log: result %d", result);
+    rebase_log_free(&log);
+    markdown_free(doc);
+}
+
+int main(void) {
+    test_map_position();
+    test_surviving_length();
+    test_rebase_command();
+    test_outdated_version();
+    return unit_report("rebase_test");
+}
@@ -0,0 +1,164 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unit.h"
+#include "../libs/resync.h"
+
+#define BLOCK RESYNC_MIN_BLOCK_SIZE // Block size every case signs its basis with
+#define MAX_SEGMENTS 8
+
+/*
+ * Each letter of a layout stands for one distinct block of generated text, so a case reads as
+ * the blocks the client holds and the blocks the server's text is made of, plus loose bytes
+ * before and after them.
+ */
+typedef struct {
+    const char *prefix;
+    const char *blocks;
+    const char *suffix;
+} layout;
+
+static const struct {
+    const char *name;
+    layout basis; // The client's copy
+    layout data; // The server's current text
+    size_t expected_copied;
+    size_t expected_literal;
+} cases[] = {
+    { "identical copies", { "", "ABCD", "" }, { "", "ABCD", "" }, 4 * BLOCK, 0 },
+    { "shifted block", { "", "ABCD", "" }, { "xyz", "ABCD", "" }, 4 * BLOCK, 3 },
+    { "blocks moved", { "", "ABCD", "" }, { "", "ADBC", "" }, 4 * BLOCK, 0 },
+    { "block deleted", { "", "ABCD", "" }, { "", "ABD", "" }, 3 * BLOCK, 0 },
+    { "block replaced", { "", "ABCD", "" }, { "", "ABED", "" }, 3 * BLOCK, BLOCK },
+    { "text appended", { "", "AB", "" }, { "", "AB", "tail" }, 2 * BLOCK, 4 },
+    { "short last block kept at the end", { "", "ABC", "tail" }, { "<", "ABC", "tail" }, 3 * BLOCK + 4, 1 },
+    { "short last block no longer at the end", { "", "ABC", "tail" }, { "", "ABC", "tail!" }, 3 * BLOCK, 5 },
+    { "empty copy", { "", "", "" }, { "", "AB", "" }, 0, 2 * BLOCK },
+    { "emptied document", { "", "AB", "" }, { "", "", "" }, 0, 0 },
+};
+
+// HELPER FUNCTIONS
+
+// Fills one block with printable bytes that depend only on the letter naming it
+static void fill_block(char *out, char letter) {
+    uint32_t x = 2463534242u ^ (uint32_t)letter * 2654435761u;
+    for (size_t i = 0; i < BLOCK; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        out[i] = (char)('a' + x % 26);
+    }
+}
+
+// Builds the text a layout describes; the caller frees it
+static char *build(const layout *l, size_t *len) {
+    size_t blocks = strlen(l->blocks);
+    char *text = malloc(strlen(l->prefix) + blocks * BLOCK + strlen(l->suffix) + 1);
+    size_t n = 0;
+    memcpy(text + n, l->prefix, strlen(l->prefix));
+    n += strlen(l->prefix);
+    for (size_t i = 0; i < blocks; i++) {
+        fill_block(text + n, l->blocks[i]);
+        n += BLOCK;
+    }
+    memcpy(text + n, l->suffix, strlen(l->suffix));
+    n += strlen(l->suffix);
+    text[n] = '\0';
+    *len = n;
+    return text;
+}
+
+// TESTS
+
+// Signs the basis as a client would, diffs the data against the signature as the server does,
+// and applies the reply to the basis, which must rebuild the data exactly
+static void test_round_trip(void) {
+    for (size_t i = 0; i < ROWS(cases); i++) {
+        size_t basis_len, data_len;
+        char *basis = build(&cases[i].basis, &basis_len);
+        char *data = build(&cases[i].data, &data_len);
+
+        char *request = NULL;
+        size_t request_len = 0;
+        FILE *out = open_memstream(&request, &request_len);
+        resync_send_signature(out, basis, basis_len, BLOCK);
+        fclose(out);
+        FILE *in = fmemopen(request, request_len, "r");
+        char line[64];
+        size_t block_size = 0, announced = 0;
+        EXPECT(fgets(line, sizeof(line), in) && sscanf(line, "RESYNC %zu %zu", &block_size, &announced) == 2 &&
+               block_size == BLOCK && announced == basis_len, "%s: bad request line", cases[i].name);
+        resync_block *blocks = resync_read_signature(in, basis_len, BLOCK);
+        EXPECT(blocks != NULL, "%s: signature rejected", cases[i].name);
+        fclose(in);
+
+        char *reply = NULL;
+        size_t reply_len = 0;
+        resync_stats sent = { 0, 0 };
+        out = open_memstream(&reply, &reply_len);
+        resync_diff(data, data_len, blocks, basis_len, BLOCK, out, &sent);
+        fclose(out);
+        EXPECT(sent.copied == cases[i].expected_copied && sent.literal == cases[i].expected_literal,
+               "%s: diff copied %zu and sent %zu, expected %zu and %zu", cases[i].name,
+               sent.copied, sent.literal, cases[i].expected_copied, cases[i].expected_literal);
+
+        resync_stats received = { 0, 0 };
+        in = fmemopen(reply, reply_len, "r");
+        char *rebuilt = resync_apply(in, basis, basis_len, BLOCK, data_len, &received);
+        fclose(in);
+        EXPECT(rebuilt && memcmp(rebuilt, data, data_len) == 0, "%s: rebuilt text differs", cases[i].name);
+        EXPECT(received.copied == sent.copied && received.literal == sent.literal,
+               "%s: apply counted %zu and %zu", cases[i].name, received.copied, received.literal);
+
+        free(rebuilt);
+        free(reply);
+        free(blocks);
+        free(request);
+        free(data);
+        free(basis);
+    }
+}
+
+static const struct {
+    const char *name;
+    const char *reply;
+} malformed_cases[] = {
+    { "copy past the end of the basis", "COPY 5 1\n" RESYNC_END_LINE },
+    { "data longer than the text", "DATA 9\n123456789" RESYNC_END_LINE },
+    { "unknown operation", "MOVE 0 1\n" RESYNC_END_LINE },
+    { "reply cut short", "DATA 2\nab" },
+    { "text shorter than announced", "DATA 2\nab" RESYNC_END_LINE },
+};
+
+// A malformed reply yields no text but is still read through to its end line
+static void test_malformed_reply(void) {
+    const char *basis = "0123456789";
+    for (size_t i = 0; i < ROWS(malformed_cases); i++) {
+        const char *reply = malformed_cases[i].reply;
+        char trailer[] = "NEXT\n";
+        size_t len = strlen(reply) + strlen(trailer);
+        char *stream = malloc(len + 1);
+        snprintf(stream, len + 1, "%s%s", reply, trailer);
+        FILE *in = fmemopen(stream, len, "r");
+        resync_stats stats;
+        char *text = resync_apply(in, basis, strlen(basis), RESYNC_MIN_BLOCK_SIZE, 4, &stats);
+        EXPECT(text == NULL, "%s: accepted", malformed_cases[i].name);
+        if (strstr(reply, RESYNC_END_LINE)) {
+            char line[16];
+            EXPECT(fgets(line, sizeof(line), in) && strcmp(line, trailer) == 0,
+                   "%s: reply not consumed up to its end line", malformed_cases[i].name);
+        }
+        free(text);
+        fclose(in);
+        free(stream);
+    }
+}
+
+int main(void) {
+    test_round_trip();
+    test_malformed_reply();
+    return unit_report("resync_test");
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unit.h"
+#include "../libs/scan.h"
+
+#define MAX_LEN 300 // Covers the unrolled steps, the single-vector steps and the scalar tails
+
+/*
+ * Each case plants its needle at every position of spans of every length up to MAX_LEN, so the
+ * match lands in every part of every vector kernel. A "<digit>. " needle only counts once it
+ * fits inside the span.
+ */
+static const struct {
+    const char *name;
+    const char *needle;
+    char filler;
+} cases[] = {
+    { "newline in plain text", "\n", 'a' },
+    { "list prefix in plain text", "7. ", 'a' },
+    { "list prefix after a digit", "0. ", '9' },
+    { "control byte", "\t", 'a' },
+    { "byte above 126", "\x80", 'a' },
+};
+
+// Checks every supported level against the scalar kernels on one span
+static void check_span(const char *name, const char *data, size_t len) {
+    const scan_kernels *scalar = scan_get_kernels(SCAN_SCALAR);
+    for (int level = SCAN_SSE2; level <= SCAN_AVX2; level++) {
+        const scan_kernels *k = scan_get_kernels((scan_level)level);
+        if (!k) {
+            continue;
+        }
+        EXPECT(k->find_newline(data, len) == scalar->find_newline(data, len),
+               "%s: %s find_newline differs at length %zu", name, k->name, len);
+        EXPECT(k->find_last_newline(data, len) == scalar->find_last_newline(data, len),
+               "%s: %s find_last_newline differs at length %zu", name, k->name, len);
+        EXPECT(k->count_newlines(data, len) == scalar->count_newlines(data, len),
+               "%s: %s count_newlines differs at length %zu", name, k->name, len);
+        EXPECT(k->find_list_prefix(data, len) == scalar->find_list_prefix(data, len),
+               "%s: %s find_list_prefix differs at length %zu", name, k->name, len);
+        EXPECT(k->find_non_printable(data, len) == scalar->find_non_printable(data, len),
+               "%s: %s find_non_printable differs at length %zu", name, k->name, len);
+    }
+}
+
+static void test_kernels_agree(void) {
+    char data[MAX_LEN];
+    for (size_t i = 0; i < ROWS(cases); i++) {
+        size_t needle_len = strlen(cases[i].needle);
+        for (size_t len = 0; len <= MAX_LEN; len++) {
+            for (size_t pos = 0; pos + needle_len <= len; pos++) {
+                memset(data, cases[i].filler, len);
+                memcpy(data + pos, cases[i].needle, needle_len);
+                check_span(cases[i].name, data, len);
+            }
+            memset(data, cases[i].filler, len);
+            check_span(cases[i].name, data, len); // No match at all
+        }
+    }
+}
+
+// Two newlines in one span: the forward search finds the first, the reverse one the last
+static void test_first_and_last(void) {
+    char data[MAX_LEN];
+    memset(data, 'a', sizeof(data));
+    data[40] = '\n';
+    data[200] = '\n';
+    const scan_kernels *k = scan;
+    EXPECT(k->find_newline(data, sizeof(data)) == data + 40, "%s: wrong first newline", k->name);
+    EXPECT(k->find_last_newline(data, sizeof(data)) == data + 200, "%s: wrong last newline", k->name);
+    EXPECT(k->count_newlines(data, sizeof(data)) == 2, "%s: wrong newline count", k->name);
+}
+
+int main(void) {
+    test_kernels_agree();
+    test_first_and_last();
+    return unit_report("scan_test");
+}
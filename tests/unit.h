@@ -0,0 +1,36 @@
+#ifndef UNIT_H
+#define UNIT_H
+
+#include <stdio.h>
+
+/*
+ * Minimal support for the table-driven unit tests: EXPECT records a failed check with the
+ * case that broke it and carries on, so one run reports every failing row.
+ */
+static int unit_failures = 0;
+
+#define EXPECT(cond, ...)                                              \
+    do {                                                               \
+        if (!(cond)) {                                                 \
+            fprintf(stderr, "%s:%d: FAIL: ", __FILE__, __LINE__);      \
+            fprintf(stderr, __VA_ARGS__);                              \
+            fputc('\n', stderr);                                       \
+            unit_failures++;                                           \
+        }                                                              \
+    } while (0)
+
+#define ROWS(table) (sizeof(table) / sizeof((table)[0]))
+
+/*
+ * Prints the outcome of a test program and returns its exit status
+ */
+static inline int unit_report(const char *name) {
+    if (unit_failures) {
+        fprintf(stderr, "%s: %d failed\n", name, unit_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif